@@ -5,6 +5,8 @@ if not defined DevEnvDir call %msvcdir%vcvars64.bat >nul
 
 cl /nologo /TC /Zi /W4 wb_alloc_test.c /link /INCREMENTAL:NO
 cl /nologo /TP /Zi /W4 wb_alloc_test_cpp.cpp /link /INCREMENTAL:NO
+cl /nologo /TC /O2 /W4 wb_alloc_bench.c /link /INCREMENTAL:NO
+cl /nologo /TC /O2 /W4 wb_alloc_replay.c /link /INCREMENTAL:NO
 
 cl  /nologo /TC /Zi /W4 /Gd /EHsc ^
 	/Gs16000000 /GS- /Gm- ^
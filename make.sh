@@ -4,11 +4,17 @@
 cc=gcc
 
 echo wb_alloc_test.c
-${cc} -x c -ansi -Wall -pedantic -Wno-format -Wno-unused-variable wb_alloc_test.c -o wb_alloc_test
+${cc} -x c -ansi -Wall -pedantic -Wno-format -Wno-unused-variable wb_alloc_test.c -o wb_alloc_test -lpthread
 
 echo wb_alloc_test_cpp.cpp
 ${cc} -x c++ --std=c++98 -Wall -Wno-unused-variable wb_alloc_test_cpp.cpp -o wb_alloc_test_cpp
 
+echo wb_alloc_bench.c
+${cc} -x c -ansi -Wall -pedantic -Wno-format -O2 wb_alloc_bench.c -o wb_alloc_bench
+
+echo wb_alloc_replay.c
+${cc} -x c -ansi -Wall -pedantic -Wno-format -O2 wb_alloc_replay.c -o wb_alloc_replay
+
 echo ""
 
 
@@ -87,6 +87,10 @@
  * size_t, ptrdiff_t, and int, respectively. Typedef these on your own and 
  * define WB_ALLOC_CUSTOM_INTEGERTYPES to ignore them.
  *
+ * #ifndef WB_ALLOC_CUSTOM_INDEX_TYPES
+ * wb_u32 and wb_u16 are used for the links of index-linked pools. They're
+ * typedef'd unsigned int and unsigned short; define this to provide your own.
+ *
  * #define WB_ALLOC_STACK_PTR wb_usize
  * #define WB_ALLOC_EXTENDED_INFO wb_isize
  * These are options for modes of wb_MemoryArena. By default they are 8 byte
@@ -97,9 +101,70 @@
  * wb_alloc uses memset and memcpy. If neither of these are present, the 
  * library includes string.h. You may define your own, and it will not.
  *
+ * #define WB_ALLOC_SOA_MAX_FIELDS 16
+ * The most fields (columns) a wb_SoaPool can have.
+ *
  * #define WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT 64
- * This defines the total number of tags available to a tagged heap. If you 
- * need more than 64, or far fewer, redefine it as you need.
+ * Tags from zero up to this are looked up directly in an array inside the 
+ * tagged heap. Any other tag (negative, or a big id or hash) still works, but
+ * goes through a hash table instead, so redefine this if you have a lot of 
+ * small tags that you use constantly.
+ *
+ * #define WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT 16
+ * How many retired tags a tagged heap can have waiting on their completion
+ * counters at once; ie: how deep your frame pipeline can get.
+ *
+ * #define WB_ALLOC_TAGGEDHEAP_FRAME_TAG_BASE
+ * Frame tags are this plus the frame number. It defaults to a big negative
+ * number, so it won't run into your own tags.
+ *
+ * #define WB_ALLOC_TAGGEDHEAP_CLASS_COUNT 4
+ * #define WB_ALLOC_TAGGEDHEAP_CLASS_SHIFT 2
+ * With TaggedHeapSizeClasses, a tagged heap hands out blocks in this many 
+ * sizes, each a quarter (1 << shift) of the one above, down from the 
+ * arenaSize; so a 2mb heap has 2mb, 512kb, 128kb and 32kb blocks.
+ *
+ * #define WB_ALLOC_TAGGEDHEAP_READER_COUNT 32
+ * How many reader threads can register with a tagged heap for the 
+ * epoch-based taggedFreeDeferred.
+ *
+ * #define WB_ALLOC_TAGGEDHEAP_THREAD_CACHE_SIZE 8
+ * How many tags a wb_TaggedHeapThread remembers a current block for. It's 
+ * direct-mapped by tag, so keep it a power of two.
+ *
+ * #define WB_ALLOC_CAS(ptr, oldValue, newValue)
+ * Compare-and-swap on a wb_usize, returning nonzero if it succeeded. The 
+ * concurrent tagged heap is built on this. It defaults to the __sync builtin
+ * on gcc/clang and _InterlockedCompareExchange on MSVC; with neither (and 
+ * without your own), TaggedHeapConcurrent isn't available.
+ *
+ * #define WB_ALLOC_POOL_PREFETCH_DISTANCE 4
+ * How many slots ahead of the current one poolIterNext prefetches. 
+ *
+ * #define WB_ALLOC_CTZ(x)
+ * #define WB_ALLOC_PREFETCH(x)
+ * Count-trailing-zeros and prefetch for the pool iterator. These default to
+ * the gcc/clang builtins (and _BitScanForward on MSVC); if you don't have 
+ * them, ctz falls back to a loop and prefetch does nothing.
+ *
+ * #define WB_ALLOC_STATS
+ * Keeps counters in every arena, pool and tagged heap: allocations, bytes,
+ * alignment waste, commits, decommits and bytes zeroed. They're read with
+ * wb_arenaStats and friends. Without this, the counters aren't even in the
+ * structs, and the snapshots only have what can be worked out from the 
+ * allocator itself (usage, committed memory, free list lengths, blocks).
+ *
+ * #define WB_ALLOC_STATS_REGISTRY_SIZE 64
+ * How many allocators can be registered with wb_statsRegister at once.
+ *
+ * #define WB_ALLOC_TRACE
+ * Records the operations of every arena, pool and tagged heap created with
+ * the Trace flag into per-thread ring buffers, for wb_alloc_replay; see 
+ * wb_traceAttach. Without this, the Trace flags do nothing.
+ *
+ * #define WB_ALLOC_THREAD_LOCAL
+ * The storage class for each thread's trace ring; __thread on gcc and 
+ * clang, and __declspec(thread) on MSVC. Only used with WB_ALLOC_TRACE.
  *
  * #define WB_ALLOC_NO_ZERO_ON_INIT
  * Whenever you call wb_allocatorInit(wb_allocator*, ...) we zero the pointer 
@@ -182,6 +247,11 @@ typedef ptrdiff_t wb_isize;
 typedef wb_isize wb_iflags;
 #endif
 
+#ifndef WB_ALLOC_CUSTOM_INDEX_TYPES
+typedef unsigned int wb_u32;
+typedef unsigned short wb_u16;
+#endif
+
 
 #ifndef WB_ALLOC_STACK_PTR
 #define WB_ALLOC_STACK_PTR wb_usize
@@ -207,6 +277,10 @@ typedef wb_isize wb_iflags;
 #define WB_ALLOC_MEMCPY memcpy
 #endif
 
+#ifndef WB_ALLOC_SOA_MAX_FIELDS
+#define WB_ALLOC_SOA_MAX_FIELDS 16
+#endif
+
 #ifndef WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT
 /* NOTE(will): if you listen to the Naughty Dog talk the tagged heap is based 
  * on, it seems like they only have ~4 tags? Something like "game", "render",
@@ -216,6 +290,115 @@ typedef wb_isize wb_iflags;
 #define WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT 64
 #endif
 
+#ifndef WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT
+#define WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT 16
+#endif
+
+#ifndef WB_ALLOC_TAGGEDHEAP_FRAME_TAG_BASE
+#define WB_ALLOC_TAGGEDHEAP_FRAME_TAG_BASE \
+	(-((wb_isize)1 << (sizeof(wb_isize) * 8 - 2)))
+#endif
+
+#ifndef WB_ALLOC_TAGGEDHEAP_CLASS_COUNT
+#define WB_ALLOC_TAGGEDHEAP_CLASS_COUNT 4
+#endif
+
+#ifndef WB_ALLOC_TAGGEDHEAP_CLASS_SHIFT
+#define WB_ALLOC_TAGGEDHEAP_CLASS_SHIFT 2
+#endif
+
+#ifndef WB_ALLOC_TAGGEDHEAP_READER_COUNT
+#define WB_ALLOC_TAGGEDHEAP_READER_COUNT 32
+#endif
+
+#ifndef WB_ALLOC_TAGGEDHEAP_THREAD_CACHE_SIZE
+#define WB_ALLOC_TAGGEDHEAP_THREAD_CACHE_SIZE 8
+#endif
+
+#ifndef WB_ALLOC_POOL_PREFETCH_DISTANCE
+#define WB_ALLOC_POOL_PREFETCH_DISTANCE 4
+#endif
+
+#ifndef WB_ALLOC_STATS_REGISTRY_SIZE
+#define WB_ALLOC_STATS_REGISTRY_SIZE 64
+#endif
+
+#ifdef WB_ALLOC_STATS
+#define wbi__stat(x) x
+#else
+#define wbi__stat(x)
+#endif
+
+#ifdef WB_ALLOC_TRACE
+#define wbi__traced(x) x
+#ifndef WB_ALLOC_THREAD_LOCAL
+#if defined(_MSC_VER)
+#define WB_ALLOC_THREAD_LOCAL __declspec(thread)
+#else
+#define WB_ALLOC_THREAD_LOCAL __thread
+#endif
+#endif
+#else
+#define wbi__traced(x)
+#endif
+
+#ifndef WB_ALLOC_CTZ
+#if defined(__GNUC__)
+#define WB_ALLOC_CTZ(x) ((sizeof(wb_usize) > sizeof(unsigned long)) ? \
+		__builtin_ctzll(x) : __builtin_ctzl((unsigned long)(x)))
+#elif defined(_MSC_VER)
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned char _BitScanForward(unsigned long* index, unsigned long mask);
+#pragma intrinsic(_BitScanForward)
+#ifdef _WIN64
+#ifdef __cplusplus
+extern "C"
+#endif
+unsigned char _BitScanForward64(unsigned long* index, unsigned __int64 mask);
+#pragma intrinsic(_BitScanForward64)
+#endif
+#endif
+#endif
+
+#ifndef WB_ALLOC_PREFETCH
+#if defined(__GNUC__)
+#define WB_ALLOC_PREFETCH(x) __builtin_prefetch(x)
+#else
+#define WB_ALLOC_PREFETCH(x)
+#endif
+#endif
+
+#ifndef WB_ALLOC_CAS
+#if defined(__GNUC__)
+#define WB_ALLOC_CAS(ptr, oldValue, newValue) \
+	__sync_bool_compare_and_swap((ptr), (oldValue), (newValue))
+#elif defined(_MSC_VER)
+#ifdef _WIN64
+#ifdef __cplusplus
+extern "C"
+#endif
+__int64 _InterlockedCompareExchange64(__int64 volatile* dest, 
+		__int64 exchange, __int64 comparand);
+#pragma intrinsic(_InterlockedCompareExchange64)
+#define WB_ALLOC_CAS(ptr, oldValue, newValue) \
+	(_InterlockedCompareExchange64((__int64 volatile*)(ptr), \
+		(__int64)(newValue), (__int64)(oldValue)) == (__int64)(oldValue))
+#else
+#ifdef __cplusplus
+extern "C"
+#endif
+long _InterlockedCompareExchange(long volatile* dest, 
+		long exchange, long comparand);
+#pragma intrinsic(_InterlockedCompareExchange)
+#define WB_ALLOC_CAS(ptr, oldValue, newValue) \
+	(_InterlockedCompareExchange((long volatile*)(ptr), \
+		(long)(newValue), (long)(oldValue)) == (long)(oldValue))
+#endif
+#endif
+#endif
+
 #define wb_CalcKilobytes(x) (((wb_usize)x) * 1024)
 #define wb_CalcMegabytes(x) (wb_CalcKilobytes((wb_usize)x) * 1024)
 #define wb_CalcGigabytes(x) (wb_CalcMegabytes((wb_usize)x) * 1024)
@@ -232,19 +415,49 @@ typedef wb_isize wb_iflags;
 #define wb_Arena_Extended 4
 #define wb_Arena_NoZeroMemory 8
 #define wb_Arena_NoRecommit 16 
+#define wb_Arena_Trace 32
 
 #define wb_Pool_Normal 0
 #define wb_Pool_FixedSize 1
 #define wb_Pool_Compacting 2
 #define wb_Pool_NoZeroMemory 4
 #define wb_Pool_NoDoubleFreeCheck 8
+#define wb_Pool_TrackOccupancy 16
+#define wb_Pool_PageSlots 32
+#define wb_Pool_GeometricGrowth 64
+#define wb_Pool_IndexLinks 128
+#define wb_Pool_ShortIndexLinks 256
+#define wb_Pool_Trace 512
+#define wbi__PoolOwnsArena 1024
 
 #define wb_TaggedHeap_Normal 0
 #define wb_TaggedHeap_FixedSize 1
 #define wb_TaggedHeap_NoZeroMemory 2
 #define wb_TaggedHeap_NoSetCommitSize 4
 #define wb_TaggedHeap_SearchForBestFit 8
+#define wb_TaggedHeap_Concurrent 16
+#define wb_TaggedHeap_SizeClasses 32
+#define wb_TaggedHeap_Trace 64
 #define wbi__TaggedHeapSearchSize 8
+#define wbi__TaggedHeapBinCount 16
+#define wbi__TaggedHeapBinShift 4
+#define wbi__TaggedHeapFrameCount (WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT + 1)
+#define wbi__TaggedTagTemp 256
+
+#define wb_Stats_Arena 1
+#define wb_Stats_Pool 2
+#define wb_Stats_TaggedHeap 3
+
+#define wb_Trace_ArenaPush 1
+#define wb_Trace_ArenaPop 2
+#define wb_Trace_ArenaStartTemp 3
+#define wb_Trace_ArenaEndTemp 4
+#define wb_Trace_ArenaClear 5
+#define wb_Trace_PoolRetrieve 6
+#define wb_Trace_PoolRelease 7
+#define wb_Trace_TaggedAlloc 8
+#define wb_Trace_TaggedFree 9
+#define wb_Trace_TaggedMerge 10
 
 /* Struct Definitions */
 
@@ -255,6 +468,46 @@ struct wb_MemoryInfo
 	wb_iflags commitFlags;
 };
 
+/* NOTE(will): the first group is only counted with WB_ALLOC_STATS; the 
+ * rest is worked out when you take a snapshot */
+typedef struct wb_AllocStats wb_AllocStats;
+struct wb_AllocStats
+{
+	const char* name;
+	wb_isize kind;
+	wb_usize allocs, frees, bytes, alignWaste;
+	wb_usize commits, decommits, zeroedBytes;
+	wb_usize highWater;
+	wb_usize used, committed;
+	wb_isize freeListLength, blockCount, tagCount;
+};
+
+/* NOTE(will): the allocator is only used as an id; value is the size, or
+ * for pools, the pointer (and for merges, the tag merged into); param is 
+ * the commitSize, elementSize, or arenaSize, so the replay can make a 
+ * matching allocator */
+typedef struct wb_TraceRecord wb_TraceRecord;
+struct wb_TraceRecord
+{
+	wb_usize sequence;
+	wb_usize allocator;
+	wb_usize value;
+	wb_isize tag;
+	wb_usize param;
+	wb_u16 op, thread;
+	wb_u32 flags;
+};
+
+typedef struct wb_TraceRing wb_TraceRing;
+struct wb_TraceRing
+{
+	wb_TraceRecord* records;
+	wb_usize capacity;
+	volatile wb_usize head, tail;
+	volatile wb_usize dropped;
+	wb_u16 thread;
+};
+
 typedef struct wb_MemoryArena wb_MemoryArena;
 struct wb_MemoryArena
 {
@@ -264,6 +517,9 @@ struct wb_MemoryArena
 	wb_MemoryInfo info;
 	wb_isize align;
 	wb_iflags flags;
+#ifdef WB_ALLOC_STATS
+	wb_AllocStats stats;
+#endif
 };
 
 typedef struct wb_MemoryPool wb_MemoryPool;
@@ -277,26 +533,184 @@ struct wb_MemoryPool
 	wb_MemoryArena* alloc;
 	wb_isize lastFilled;
 	wb_iflags flags;
+	wb_usize* occupancy;
+	wb_isize occupancyWords;
+	wb_MemoryArena* occupancyAlloc;
+	wb_isize unlisted, freeHint;
+	wb_isize growCount;
+#ifdef WB_ALLOC_STATS
+	wb_AllocStats stats;
+#endif
+};
+
+typedef void (*wb_PoolRelocateProc)(void* userdata, void* oldPtr, void* newPtr);
+
+typedef struct wb_SoaPool wb_SoaPool;
+struct wb_SoaPool
+{
+	const char* name;
+	wb_MemoryPool* indices;
+	void* columns[WB_ALLOC_SOA_MAX_FIELDS];
+	wb_usize fieldSizes[WB_ALLOC_SOA_MAX_FIELDS];
+	wb_isize fieldCount, capacity, maxCapacity;
+	void* reservation;
+	wb_usize reservationSize;
+	wb_MemoryInfo info;
+	wb_iflags flags;
+};
+
+typedef struct wb_PoolIterator wb_PoolIterator;
+struct wb_PoolIterator
+{
+	wb_MemoryPool* pool;
+	wb_isize index, end;
+	wb_usize word;
 };
 
 typedef struct wbi__TaggedHeapArena wbi__TaggedHeapArena;
+#define wbi__TaggedBlockLarge 1
+/* NOTE(will): the size class of a block lives in the flags above this; 
+ * class 0 is a whole pool block, and each class after is carved smaller */
+#define wbi__TaggedBlockClassShift 4
+#define wbi__taggedBlockClass(block) \
+	((block)->flags >> wbi__TaggedBlockClassShift)
+
 struct wbi__TaggedHeapArena
 {
 	wb_isize tag;
 	wbi__TaggedHeapArena *next;
+	wbi__TaggedHeapArena *binNext, *binPrev;
 	void *head, *end;
+	wb_iflags flags;
 	char buffer;
 };
 
+/* NOTE(will): blocks with room left over get filed by how much room that is,
+ * log2 style: bin i holds blocks with [16 << i, 32 << i) bytes free (and the
+ * last bin, anything bigger) */
+typedef struct wbi__TaggedHeapBins wbi__TaggedHeapBins;
+struct wbi__TaggedHeapBins
+{
+	wbi__TaggedHeapArena* heads[wbi__TaggedHeapBinCount];
+	wbi__TaggedHeapArena* tails[wbi__TaggedHeapBinCount];
+	wb_usize mask;
+};
+
+typedef struct wbi__TaggedHeapTag wbi__TaggedHeapTag;
+struct wbi__TaggedHeapTag
+{
+	wb_isize tag;
+	wbi__TaggedHeapTag* next;
+	wbi__TaggedHeapArena* volatile blocks;
+	wbi__TaggedHeapArena* tail;
+	wbi__TaggedHeapArena* volatile large;
+	wbi__TaggedHeapArena* largeTail;
+	wbi__TaggedHeapBins* bins;
+	wb_iflags flags;
+	wbi__TaggedHeapArena *tempBlock, *tempLarge;
+	void* tempHead;
+	wbi__TaggedHeapArena* rewindBlock;
+	void* rewindHead;
+	wb_usize rewinds;
+	volatile wb_usize generation, blockCount;
+};
+
+typedef struct wbi__TaggedHeapRetired wbi__TaggedHeapRetired;
+struct wbi__TaggedHeapRetired
+{
+	wb_isize tag;
+	volatile wb_usize* counter;
+	wb_usize target;
+};
+
+/* NOTE(will): each reader gets its own cache line, so pinning never 
+ * bounces a line between readers */
+typedef struct wbi__TaggedHeapReader wbi__TaggedHeapReader;
+struct wbi__TaggedHeapReader
+{
+	volatile wb_usize epoch, used;
+	char pad[64 - 2 * sizeof(wb_usize)];
+};
+
+typedef struct wbi__TaggedHeapLimbo wbi__TaggedHeapLimbo;
+struct wbi__TaggedHeapLimbo
+{
+	wbi__TaggedHeapTag detached;
+	wb_usize epoch;
+	wbi__TaggedHeapLimbo* next;
+};
+
 typedef struct wb_TaggedHeap wb_TaggedHeap;
+
+typedef struct wb_TaggedHeapThread wb_TaggedHeapThread;
+struct wb_TaggedHeapThread
+{
+	wb_TaggedHeap* heap;
+	wb_isize tags[WB_ALLOC_TAGGEDHEAP_THREAD_CACHE_SIZE];
+	wb_usize generations[WB_ALLOC_TAGGEDHEAP_THREAD_CACHE_SIZE];
+	wbi__TaggedHeapTag* entries[WB_ALLOC_TAGGEDHEAP_THREAD_CACHE_SIZE];
+	wbi__TaggedHeapArena* blocks[WB_ALLOC_TAGGEDHEAP_THREAD_CACHE_SIZE];
+#ifdef WB_ALLOC_STATS
+	wb_usize allocs, bytes;
+#endif
+};
+
 struct wb_TaggedHeap
 {
 	const char* name;
 	wb_MemoryPool pool;
-	wbi__TaggedHeapArena* arenas[WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT];
+	/* NOTE(will): frame tags live past the direct ones, in a ring that's 
+	 * one longer than the retire ring, so the frame a slot last held has
+	 * always been freed by the time the slot comes around again */
+	wbi__TaggedHeapTag tags[WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT + 
+		wbi__TaggedHeapFrameCount];
+	wbi__TaggedHeapTag** buckets;
+	wb_isize bucketCount, hashedCount;
+	wb_MemoryPool *tagPool, *binPool;
+	wb_MemoryArena* bucketAlloc;
+	volatile wb_usize freeBlocks, cleanBlocks, coldBlocks, hotBlockCount;
+	wbi__TaggedHeapArena* classBlocks[WB_ALLOC_TAGGEDHEAP_CLASS_COUNT];
+	wb_isize classFreed;
+	volatile wb_usize lock, sharedLock, tagLock, nextGeneration;
+	wb_isize retainBlocks;
+	wb_TaggedHeapThread shared;
+	wbi__TaggedHeapRetired retired[WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT];
+	wb_isize retiredCount;
+	volatile wb_isize frame;
+	volatile wb_usize retireLock;
+	wbi__TaggedHeapReader readers[WB_ALLOC_TAGGEDHEAP_READER_COUNT];
+	volatile wb_usize epoch, readerCount, limboLock;
+	wbi__TaggedHeapLimbo* limbo;
+	wb_MemoryPool* limboPool;
 	wb_MemoryInfo info;
 	wb_usize arenaSize, align;
 	wb_iflags flags;
+#ifdef WB_ALLOC_STATS
+	wb_AllocStats stats;
+#endif
+};
+
+typedef struct wb_TaggedPool wb_TaggedPool;
+struct wb_TaggedPool
+{
+	const char* name;
+	wb_TaggedHeap* heap;
+	wb_isize tag;
+	wb_usize elementSize;
+	void** freeList;
+	wbi__TaggedHeapTag* entry;
+	wb_usize generation, rewinds;
+	wb_isize count;
+};
+
+typedef struct wb_TaggedObject wb_TaggedObject;
+struct wb_TaggedObject
+{
+	void* ptr;
+	void* moved;
+	wb_usize size, align;
+	const wb_usize* pointers;
+	wb_isize pointerCount;
 };
 
 /* Function Prototypes */
@@ -333,22 +747,199 @@ void* wb_arenaPush(wb_MemoryArena* arena, wb_isize size);
  * This means that you can treat the pool's slots field as an array of your
  * struct/union and iterate over it without expecting holes; however, any 
  * retrieve/release operations can invalidate your pointers
+ *
+ * The PoolPageSlots flag is meant for big elements, a page or more each 
+ * (think I/O buffers). Elements are rounded up to whole pages and page 
+ * aligned, and poolRelease decommits and recommits the slot, so a released 
+ * element doesn't hold onto physical memory. Because of that, the free list
+ * can't live in the slots anymore, so this turns on PoolTrackOccupancy and
+ * finds free slots through the bitmap instead. Retrieve never memsets; the
+ * pages it hands out are always fresh from the OS. This doesn't work with
+ * PoolFixedSize or PoolCompacting.
  */
 WB_ALLOC_API 
 void* wb_poolRetrieve(wb_MemoryPool* pool);
 WB_ALLOC_API 
 void wb_poolRelease(wb_MemoryPool* pool, void* ptr);
 
+/* poolRetrieveBatch and poolReleaseBatch do the same thing as the single
+ * versions, but for count elements at once.
+ *
+ * poolRetrieveBatch writes the pointers into out, and returns how many it
+ * managed to get (this is only less than count if a fixed-size pool runs
+ * out). It empties the free list first, then carves the rest as a single
+ * contiguous run past lastFilled, which is zeroed with one memset.
+ *
+ * poolReleaseBatch links the pointers together and splices the whole chain
+ * onto the free list, so the first pointer in the array is the next one
+ * retrieved. Compacting pools fall back to releasing one at a time. The 
+ * double free check covers the whole batch up front (including the same 
+ * pointer being in it twice), and if it fails, nothing is released. 
+ * Pools with PoolTrackOccupancy check the bitmap; otherwise the check 
+ * sorts ptrs by address first (so then it's the lowest one that's 
+ * retrieved next).
+ */
+WB_ALLOC_API
+wb_isize wb_poolRetrieveBatch(wb_MemoryPool* pool, void** out, wb_isize count);
+WB_ALLOC_API
+void wb_poolReleaseBatch(wb_MemoryPool* pool, void** ptrs, wb_isize count);
+
+/* poolIterBegin and poolIterNext walk the live elements of a pool in slot
+ * order, skipping the holes left by poolRelease. poolIterNext returns NULL
+ * once it runs out.
+ *
+ * This needs the PoolTrackOccupancy flag, which keeps a bitmap with a bit 
+ * per slot on the side. Empty words of the bitmap are skipped wholesale, and
+ * the iterator prefetches WB_ALLOC_POOL_PREFETCH_DISTANCE slots ahead.
+ * Compacting pools don't need (or keep) the bitmap; their iterator just 
+ * walks the first count slots.
+ *
+ * It's safe to release the element you were just handed. Elements retrieved
+ * during iteration may or may not be visited.
+ */
+WB_ALLOC_API
+void wb_poolIterBegin(wb_MemoryPool* pool, wb_PoolIterator* iter);
+WB_ALLOC_API
+void* wb_poolIterNext(wb_PoolIterator* iter);
+
+/* poolDefragment moves live elements from the end of the pool into the
+ * lowest free slots, then lowers lastFilled past them, so a pool that was
+ * once large and is now mostly empty packs itself back toward the front.
+ * Every time it moves an element, it calls relocate with the old and new 
+ * pointers, so you can fix up anything that pointed at it.
+ *
+ * It does at most maxMoves moves per call, so you can spread the work out
+ * over a few frames; it returns the number of holes left below lastFilled,
+ * which is zero once the pool is dense. Like iteration, this needs the
+ * PoolTrackOccupancy flag.
+ *
+ * Free slots aren't threaded back onto the free list afterwards; instead,
+ * once the free list runs dry, retrieve relinks the lowest free slots it
+ * can find in the bitmap, a word at a time, in address order.
+ */
+WB_ALLOC_API
+wb_isize wb_poolDefragment(wb_MemoryPool* pool, 
+		wb_PoolRelocateProc relocate, void* userdata,
+		wb_isize maxMoves);
+
+/* poolTrim gives memory back to the operating system after a spike. It
+ * lowers lastFilled past any free slots at the end of the pool, then 
+ * decommits and recommits every page made up entirely of free slots, 
+ * including everything committed past lastFilled. Recommitted pages are 
+ * zeroed and don't take up physical memory until they're touched again.
+ *
+ * The free list is dropped the same way poolDefragment does, so nothing
+ * writes free list pointers into the trimmed pages until retrieve actually
+ * needs those slots. Returns the number of bytes given back.
+ *
+ * This needs PoolTrackOccupancy. Fixed-size pools don't own their memory,
+ * so for them this only lowers lastFilled.
+ */
+WB_ALLOC_API
+wb_isize wb_poolTrim(wb_MemoryPool* pool);
+
+/* When a pool runs out of room, it commits more memory right after its
+ * slots. By default it grows by info.commitSize bytes at a time (or one 
+ * element, if that's bigger). Set pool->growCount to grow by that many 
+ * elements instead, and/or use the PoolGeometricGrowth flag to at least 
+ * double the capacity each time. Either way, growth is rounded up to whole
+ * pages.
+ *
+ * poolReserve makes sure the next count retrieves won't have to commit
+ * anything, counting free slots the pool already has. If prefault is 
+ * nonzero, it also touches each new page so the OS maps them now, rather 
+ * than on first use. Returns zero if it couldn't make the room.
+ */
+WB_ALLOC_API
+wb_isize wb_poolReserve(wb_MemoryPool* pool, wb_isize count, wb_isize prefault);
+
+/* The free list is LIFO, so after a lot of churn, retrieves hand out slots
+ * from all over the pool. poolSortFreeList puts it back in address order,
+ * so that new elements fill the lowest pages first, which is better for
+ * the cache and leaves the high pages free for poolTrim.
+ *
+ * For PoolTrackOccupancy pools, this is free: the list is dropped, and 
+ * retrieve relinks free slots from the bitmap a word at a time, lowest 
+ * first. Otherwise, the list is merge sorted in place.
+ */
+WB_ALLOC_API
+void wb_poolSortFreeList(wb_MemoryPool* pool);
+
+/* Normally, the free list is threaded through the slots with pointers, so
+ * every element has to be at least sizeof(void*). The PoolIndexLinks flag
+ * links free slots with 32-bit slot indices instead, and 
+ * PoolShortIndexLinks with 16-bit ones, so elements only need to be 4 (or
+ * 2) bytes, and may be any size past that, unaligned or not (eg: 6 bytes). 
+ * A short-linked pool holds at most 65535 elements.
+ *
+ * poolIndex and poolFromIndex convert between pointers and slot indices,
+ * so you can store your own references into the pool as wb_u32 (or wb_u16)
+ * instead of pointers, too.
+ */
+WB_ALLOC_API
+wb_isize wb_poolIndex(wb_MemoryPool* pool, void* ptr);
+WB_ALLOC_API
+void* wb_poolFromIndex(wb_MemoryPool* pool, wb_isize index);
+
+/* A SoaPool is a pool where each field of the element lives in its own 
+ * column (structure-of-arrays), rather than storing whole elements next to
+ * each other. You describe the element with an array of field sizes.
+ *
+ * Handing out and taking back indices is done by a regular MemoryPool 
+ * under the hood (soa->indices), so it takes the same wb_Pool_* flags: 
+ * TrackOccupancy lets you iterate with soaIterBegin/soaIterNext, and 
+ * NoZeroMemory skips zeroing the fields on retrieve. Compacting and 
+ * FixedSize aren't supported.
+ *
+ * All the columns live in one big virtual reservation, each one page 
+ * aligned and sized for the most elements that could ever fit, and they 
+ * are committed together as the pool grows. This means the column pointers
+ * never move, and a loop over soaColumn(soa, field) from 0 to 
+ * soa->indices->lastFilled reads nothing but that field.
+ *
+ * soaRetrieve returns the index of the new element, or -1 if it failed.
+ */
+WB_ALLOC_API
+wb_isize wb_soaRetrieve(wb_SoaPool* soa);
+WB_ALLOC_API
+void wb_soaRelease(wb_SoaPool* soa, wb_isize index);
+
+WB_ALLOC_API
+void* wb_soaColumn(wb_SoaPool* soa, wb_isize field);
+WB_ALLOC_API
+void* wb_soaField(wb_SoaPool* soa, wb_isize field, wb_isize index);
+
+WB_ALLOC_API
+void wb_soaIterBegin(wb_SoaPool* soa, wb_PoolIterator* iter);
+WB_ALLOC_API
+wb_isize wb_soaIterNext(wb_PoolIterator* iter);
+
 /* taggedAlloc behaves much like arenaPush, returning a pointer to a segment
- * of memory that is safe to write to. However, you cannot allocate more than
- * the arenaSize field of the heap at once; eg: if arenaSize is 1 megabyte, 
- * you cannot allocate anything larger than that in that heap, ever. 
+ * of memory that is safe to write to. Anything larger than the arenaSize of 
+ * the heap doesn't fit in a block, so it gets its own page-aligned mapping
+ * instead, which is linked to the tag like any other block and unmapped when
+ * the tag is freed. (A fixed-size heap has nowhere to map them from, so 
+ * there you still cannot allocate more than arenaSize at once.)
  *
  * Internally, a tagged heap is a memory pool of arenas (simlified ones rather
  * than a full MemoryArena). It, by default, selects the first arena in the
- * list, but you can set the TaggedHeapSearchForBestFit flag, which will search
- * for (the first eight or so) arenas that can fit the object, then put it into
- * the one with the smallest space remaining. 
+ * list, but you can set the TaggedHeapSearchForBestFit flag. Then, whenever
+ * a tag moves on to a new arena, the old one is filed in a per-tag index by
+ * how much room it has left, and allocations that don't fit the current 
+ * arena go into the tightest indexed one that fits, found by looking 
+ * through one size bin rather than walking the list. (Fixed-size heaps 
+ * can't make the index, so they check the first eight or so arenas that 
+ * fit instead.)
+ *
+ * With TaggedHeapSizeClasses, blocks come in a few sizes (see 
+ * WB_ALLOC_TAGGEDHEAP_CLASS_COUNT). The smaller ones are carved out of 
+ * whole blocks from the same pool, so it's all still one reservation. A tag
+ * gets the smallest size for its first block, and the next size up for 
+ * each block after that, until it's getting whole ones; so lots of tags 
+ * that only hold a little don't each pin down a whole arenaSize of memory.
+ * Once all the pieces of a carved block are free, taggedTrim (or a free, 
+ * if retainBlocks is set) puts it back together, so it can be decommitted
+ * or handed to a tag that needs a whole one.
  *
  * taggedFree allows you to free all allocations on a single tag at once. 
  * If you do not specify TaggedHeapNoZeroMemory, it will also memset everything
@@ -360,6 +951,300 @@ void* wb_taggedAlloc(wb_TaggedHeap* heap, wb_isize tag, wb_usize size);
 WB_ALLOC_API 
 void wb_taggedFree(wb_TaggedHeap* heap, wb_isize tag);
 
+/* Tags can have the same modes as a MemoryArena: taggedSetMode takes 
+ * ArenaStack and/or ArenaExtended, and has to be called while the tag is 
+ * empty; the mode lasts until the tag is freed. taggedAllocEx also takes 
+ * an alignment (a power of two; 0 is the heap's default of 8) and, for 
+ * extended tags, the info that goes right before the allocation. 
+ * taggedPop undoes the last allocation in a stack tag, handing its block 
+ * back once it's empty.
+ *
+ * taggedStartTemp and taggedEndTemp work on any tag: everything allocated
+ * into the tag in between is thrown away at the end, including any blocks
+ * it had to take on. Like the arena's, temp scopes don't nest.
+ *
+ * While a tag has a mode or a temp scope, its allocations always go at the
+ * end of its newest block (so best fit is off for it), and a stack tag 
+ * can't hold anything bigger than the arenaSize. Other tags don't pay 
+ * anything for any of this. None of these work on a concurrent heap.
+ */
+WB_ALLOC_API
+void wb_taggedSetMode(wb_TaggedHeap* heap, wb_isize tag, wb_iflags flags);
+WB_ALLOC_API
+void* wb_taggedAllocEx(wb_TaggedHeap* heap, wb_isize tag, wb_usize size, 
+		wb_usize align, WB_ALLOC_EXTENDED_INFO extended);
+WB_ALLOC_API
+void wb_taggedPop(wb_TaggedHeap* heap, wb_isize tag);
+WB_ALLOC_API
+void wb_taggedStartTemp(wb_TaggedHeap* heap, wb_isize tag);
+WB_ALLOC_API
+void wb_taggedEndTemp(wb_TaggedHeap* heap, wb_isize tag);
+
+/* With the TaggedHeapConcurrent flag, a tagged heap can be shared between
+ * the threads (or fibers) of a job system. Each worker keeps its own 
+ * wb_TaggedHeapThread, which holds the worker's current block for the last
+ * few tags it used; taggedThreadAlloc bumps that block with no atomics or
+ * locks at all, and only goes to the heap when the block fills up. 
+ *
+ * Blocks come from a lock-free stack shared by the whole heap, and every 
+ * block a thread takes for a tag is linked onto that tag, so taggedFree 
+ * reclaims all threads' blocks at once. Freeing a tag bumps its generation,
+ * which is how the threads find out their cached blocks are gone.
+ *
+ * Freeing a tag while another thread is still allocating into it is a race
+ * (just like it would be to keep using the memory), so do it once the jobs
+ * using the tag are done. On a concurrent heap, plain taggedAlloc is safe 
+ * too, but it takes a lock; use a thread context wherever you can.
+ */
+WB_ALLOC_API
+void wb_taggedThreadInit(wb_TaggedHeapThread* thread, wb_TaggedHeap* heap);
+WB_ALLOC_API
+void* wb_taggedThreadAlloc(wb_TaggedHeapThread* thread, 
+		wb_isize tag, wb_usize size);
+
+/* Pipelined engines can't free a frame's memory when the frame ends; the
+ * render thread (or GPU) might be a frame or two behind. taggedRetire 
+ * hands a tag back to the heap along with a completion counter: the tag is
+ * freed once *counter >= target (a NULL counter means right away). 
+ * taggedFrameCollect frees every retired tag that's done, and returns how
+ * many it freed. If more than WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT tags are 
+ * waiting, taggedRetire spins until the oldest one completes.
+ *
+ * Frame tags build this in: taggedFrameTag is the tag for the current 
+ * frame, so allocating per-frame memory is just a taggedAlloc (or a 
+ * taggedThreadAlloc) into it. When the frame is submitted, taggedFrameAdvance
+ * retires the current frame tag against the counter, collects whatever 
+ * earlier frames have finished, and returns the new frame's tag. Frame 
+ * tags have their own slots next to the direct tags, so they never go 
+ * through the hash table, and they work on fixed-size heaps too.
+ *
+ *	frameTag = wb_taggedFrameTag(heap);
+ *	... jobs allocate into frameTag ...
+ *	frameTag = wb_taggedFrameAdvance(heap, &gpuFramesDone, frameNumber);
+ */
+WB_ALLOC_API
+void wb_taggedRetire(wb_TaggedHeap* heap, wb_isize tag, 
+		volatile wb_usize* counter, wb_usize target);
+WB_ALLOC_API
+wb_isize wb_taggedFrameCollect(wb_TaggedHeap* heap);
+WB_ALLOC_API
+wb_isize wb_taggedFrameTag(wb_TaggedHeap* heap);
+WB_ALLOC_API
+wb_isize wb_taggedFrameAdvance(wb_TaggedHeap* heap, 
+		volatile wb_usize* counter, wb_usize target);
+
+/* taggedMerge moves everything allocated in the from tag over to the into 
+ * tag, without copying anything; it just splices the block lists together,
+ * so it takes the same time no matter how big the tag is. Afterwards from 
+ * is empty, and everything that was in it is freed along with into. This 
+ * is how you'd promote, say, a level-load tag to a persistent one. With 
+ * best fit on, the merged blocks' leftover room is open to into's later 
+ * allocations too. Both tags have to be in the same mode (see 
+ * taggedSetMode below), and into can't be a stack tag or be in a temp 
+ * scope.
+ *
+ * Like taggedFree, don't merge tags that other threads are allocating into.
+ */
+WB_ALLOC_API
+void wb_taggedMerge(wb_TaggedHeap* heap, wb_isize from, wb_isize into);
+
+/* taggedFree hands a tag's blocks straight back for reuse, which is no 
+ * good if other threads might still be reading what was in it. For that,
+ * there's epoch-based reclamation: each reader thread gets a slot from 
+ * taggedReaderRegister, and brackets its reads with taggedReadBegin and
+ * taggedReadEnd (each of which is one atomic op). Once the owner has made
+ * the data unreachable, taggedFreeDeferred takes the tag's memory away 
+ * from the tag (so the tag can be used again right away) and holds on to
+ * it until every reader that might have seen it has finished its read.
+ * taggedReclaim frees whatever's safe to, and returns how many tags it 
+ * freed; taggedFreeDeferred calls it too, so you only need it if you want
+ * memory back sooner.
+ *
+ *	reader:	wb_taggedReadBegin(heap, slot);
+ *			... walk the shared data ...
+ *			wb_taggedReadEnd(heap, slot);
+ *
+ *	owner:	publish the new data, unlink the old;
+ *			wb_taggedFreeDeferred(heap, oldTag);
+ *
+ * Read sections don't nest, and a reader that never ends its read holds 
+ * on to every deferred tag from then on, so keep them short. There are 
+ * WB_ALLOC_TAGGEDHEAP_READER_COUNT slots; a thread that's done reading 
+ * for good hands its slot back with taggedReaderUnregister, and the next 
+ * taggedReaderRegister can take it.
+ */
+WB_ALLOC_API
+wb_isize wb_taggedReaderRegister(wb_TaggedHeap* heap);
+WB_ALLOC_API
+void wb_taggedReaderUnregister(wb_TaggedHeap* heap, wb_isize reader);
+WB_ALLOC_API
+void wb_taggedReadBegin(wb_TaggedHeap* heap, wb_isize reader);
+WB_ALLOC_API
+void wb_taggedReadEnd(wb_TaggedHeap* heap, wb_isize reader);
+WB_ALLOC_API
+void wb_taggedFreeDeferred(wb_TaggedHeap* heap, wb_isize tag);
+WB_ALLOC_API
+wb_isize wb_taggedReclaim(wb_TaggedHeap* heap);
+
+/* After a long time and a lot of best-fit placement, a tag can end up 
+ * spread thin over lots of blocks. taggedEvacuate copies the live objects
+ * in the from tag over to the into tag, packed together, and then frees 
+ * from. You describe each live object with a wb_TaggedObject: 
+ *  - ptr and size (and align; 0 is the default) say where it is
+ *  - pointers is a list of pointerCount offsets into the object where it 
+ *    keeps pointers; any of those that point into an evacuated object are
+ *    fixed up to point at the new copy (other pointers are left alone)
+ *  - moved is filled in with the object's new address
+ * The objects array comes back sorted by ptr, and they're copied in that 
+ * order, so neighbours stay neighbours. If from has the ArenaExtended 
+ * mode, each object's extended info goes along with it, so into has to be
+ * extended too. On a concurrent heap, objects can't ask for more than the
+ * heap's alignment.
+ *
+ * For pointers from outside the tag into it, taggedForward looks up where
+ * the object a pointer points into has moved to (after an evacuation, 
+ * with the same array), and returns the pointer unchanged if it's not in
+ * any of them.
+ *
+ * taggedEvacuate returns the number of objects moved, or -1 if it can't 
+ * do it: from doesn't exist, or an object isn't entirely inside memory 
+ * from has allocated (unless WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS is 
+ * defined, in which case it's not checked). If it runs out of memory, 
+ * from is left as it was and the copies it had made are taken back out 
+ * of into (except on a concurrent heap, where they stay in into until 
+ * it's freed). Nobody else can be using either tag while it runs.
+ */
+WB_ALLOC_API
+wb_isize wb_taggedEvacuate(wb_TaggedHeap* heap, wb_isize from, wb_isize into,
+		wb_TaggedObject* objects, wb_isize count);
+WB_ALLOC_API
+void* wb_taggedForward(wb_TaggedObject* objects, wb_isize count, void* ptr);
+
+/* Freed blocks stay committed, so they're fast to hand out again, but a 
+ * one-off spike would otherwise keep all that memory resident forever. 
+ * taggedTrim decommits free blocks until only keep of them are left 
+ * committed, and returns how many it decommitted. The decommitted blocks 
+ * are kept around and reused once the committed ones run out, and since 
+ * the OS hands them back zeroed, they don't need to be memset either.
+ *
+ * To do this automatically, set heap->retainBlocks; whenever a free leaves
+ * more than that many committed blocks, the extras are decommitted on the
+ * spot. It defaults to -1, which keeps everything. Fixed-size heaps can't 
+ * decommit anything, so this does nothing for them.
+ */
+WB_ALLOC_API
+wb_isize wb_taggedTrim(wb_TaggedHeap* heap, wb_isize keep);
+
+/* Freed blocks have to be zeroed before they're handed out again, and by
+ * default that's a memset of as much of the block as its tag used, right 
+ * when a tag needs more room. taggedZeroBlocks does that ahead of time 
+ * instead: it zeroes up to max freed blocks and puts them on a list that 
+ * new blocks come from first, and returns how many it zeroed. Call it 
+ * from a low-priority worker thread (the heap needs TaggedHeapConcurrent 
+ * then), or whenever there's idle time, and tags can grow without zeroing
+ * anything inline.
+ *
+ *	while(running) {
+ *		if(!wb_taggedZeroBlocks(heap, 4)) sleepForABit();
+ *	}
+ *
+ * Brand new blocks already come zeroed from the OS, as do trimmed ones, 
+ * so they never need it.
+ */
+WB_ALLOC_API
+wb_isize wb_taggedZeroBlocks(wb_TaggedHeap* heap, wb_isize max);
+
+/* A TaggedPool is a pool of same-sized elements living in a tag, for when
+ * you want to free things one at a time but still throw the whole lot out
+ * with the tag. taggedPoolRetrieve takes an element off the pool's free 
+ * list, or allocates a new one into the tag, and taggedPoolRelease puts 
+ * one back on the free list. There's nothing to destroy: when the tag is 
+ * freed, so is everything in the pool, and the pool notices (by the tag's
+ * generation) and starts over empty the next time it's used. The same 
+ * goes for a taggedPop or taggedEndTemp that gives one of the tag's blocks
+ * back. One that only rewinds part of a block just cuts the free list off
+ * at the first element it took back. Releasing an element from before the
+ * tag was freed is an error.
+ *
+ * A TaggedPool isn't thread-safe, even on a concurrent heap; give each 
+ * thread its own (they can share a tag).
+ */
+WB_ALLOC_API
+void wb_taggedPoolInit(wb_TaggedPool* pool, wb_TaggedHeap* heap, 
+		wb_isize tag, wb_usize elementSize);
+WB_ALLOC_API
+void* wb_taggedPoolRetrieve(wb_TaggedPool* pool);
+WB_ALLOC_API
+void wb_taggedPoolRelease(wb_TaggedPool* pool, void* ptr);
+
+/* arenaStats, poolStats and taggedStats fill in a wb_AllocStats snapshot
+ * of an allocator. With WB_ALLOC_STATS defined, that includes running 
+ * counts of allocations and bytes, the bytes lost to alignment, how many
+ * times memory was committed and decommitted, and how many bytes were 
+ * zeroed. Every snapshot has the name, the bytes in use and committed, the
+ * high-water mark, and for pools, the length of the free list.
+ *
+ * A pool grows by committing more of its arena, so its snapshot includes 
+ * the arena's commits; likewise, a tagged heap's includes its block pool
+ * and arena. For a tagged heap, blockCount and tagCount are the blocks 
+ * held by tags, and how many tags hold any; freeListLength is the number 
+ * of freed blocks still committed. taggedTagStats is the same for a single
+ * tag (the counters aren't kept per tag, so those are left at zero). 
+ * Allocations made with taggedThreadAlloc only show up once that thread 
+ * next needs a new block.
+ *
+ * These walk the tags and their blocks, so on a concurrent heap, don't 
+ * take one while a tag could be freed or merged.
+ *
+ * statsRegister adds an allocator to a process-wide registry (kind is one
+ * of wb_Stats_Arena, wb_Stats_Pool or wb_Stats_TaggedHeap), and 
+ * statsCollect takes a snapshot of up to max registered allocators at 
+ * once, returning how many it wrote. Snapshots take the allocator's name 
+ * field when they're taken, so name them whenever you like. Unregister an
+ * allocator before destroying it.
+ */
+WB_ALLOC_API
+void wb_arenaStats(wb_MemoryArena* arena, wb_AllocStats* stats);
+WB_ALLOC_API
+void wb_poolStats(wb_MemoryPool* pool, wb_AllocStats* stats);
+WB_ALLOC_API
+void wb_taggedStats(wb_TaggedHeap* heap, wb_AllocStats* stats);
+WB_ALLOC_API
+void wb_taggedTagStats(wb_TaggedHeap* heap, wb_isize tag, 
+		wb_AllocStats* stats);
+WB_ALLOC_API
+wb_isize wb_statsRegister(void* allocator, wb_isize kind);
+WB_ALLOC_API
+void wb_statsUnregister(void* allocator);
+WB_ALLOC_API
+wb_isize wb_statsCollect(wb_AllocStats* out, wb_isize max);
+
+/* With WB_ALLOC_TRACE defined, arenas, pools and tagged heaps created with
+ * wb_Arena_Trace, wb_Pool_Trace or wb_TaggedHeap_Trace record what's done
+ * with them: arena pushes, pops, temp scopes and clears; pool retrieves and
+ * releases; and tagged allocs, frees and merges (allocEx is recorded as a
+ * plain alloc, and deferred and retired frees when the tag is detached).
+ *
+ * Records go to the ring buffer of the thread doing the work. Set one up 
+ * with traceRingInit, on a buffer of capacity records (a power of two), 
+ * and hand it to traceAttach on that thread (NULL detaches it). Nothing 
+ * is recorded on threads without a ring. Recording never blocks or locks;
+ * if the ring is full, the record is dropped, and counted in dropped.
+ *
+ * traceRead takes up to max records out of a ring, and can be called from
+ * any one thread while the owner keeps recording; write them out with 
+ * fwrite and wb_alloc_replay can run them again. Every record has a 
+ * sequence number from a process-wide counter, so the replay can put the 
+ * threads back in order.
+ */
+WB_ALLOC_API
+void wb_traceRingInit(wb_TraceRing* ring, wb_TraceRecord* records, 
+		wb_usize capacity);
+WB_ALLOC_API
+void wb_traceAttach(wb_TraceRing* ring);
+WB_ALLOC_API
+wb_isize wb_traceRead(wb_TraceRing* ring, wb_TraceRecord* out, wb_isize max);
+
 #ifdef WB_ALLOC_CPLUSPLUS_FEATURES
 template<typename T>
 WB_ALLOC_API 
@@ -379,6 +1264,18 @@ template<typename T>
 WB_ALLOC_API 
 void wb_poolRelease(wb_MemoryPool* pool, T* ptr);
 
+template<typename T>
+WB_ALLOC_API
+wb_isize wb_poolRetrieveBatch(wb_MemoryPool* pool, T** out, wb_isize count);
+
+template<typename T>
+WB_ALLOC_API
+void wb_poolReleaseBatch(wb_MemoryPool* pool, T** ptrs, wb_isize count);
+
+template<typename T>
+WB_ALLOC_API
+T* wb_poolIterNext(wb_PoolIterator* iter);
+
 
 template<typename T>
 WB_ALLOC_API 
@@ -398,10 +1295,51 @@ wb_MemoryPool* wb_poolFixedSizeBootstrap(
 
 
 template<typename T>
-WB_ALLOC_API 
-T* wb_taggedAlloc(wb_TaggedHeap* heap, wb_isize tag, int n = 1);
-#endif
-
+WB_ALLOC_API
+T* wb_soaColumn(wb_SoaPool* soa, wb_isize field);
+
+template<typename T>
+WB_ALLOC_API
+T* wb_soaField(wb_SoaPool* soa, wb_isize field, wb_isize index);
+
+template<typename A, typename B>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags);
+
+template<typename A, typename B, typename C>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags);
+
+template<typename A, typename B, typename C, typename D>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags);
+
+template<typename A, typename B, typename C, typename D, typename E>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags);
+
+template<typename A, typename B, typename C, typename D, typename E, typename F>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags);
+
+template<typename T>
+WB_ALLOC_API 
+T* wb_taggedAlloc(wb_TaggedHeap* heap, wb_isize tag, int n = 1);
+
+template<typename T>
+WB_ALLOC_API 
+T* wb_taggedAllocEx(wb_TaggedHeap* heap, wb_isize tag, 
+		WB_ALLOC_EXTENDED_INFO extended, int n = 1);
+
+template<typename T>
+WB_ALLOC_API 
+T* wb_taggedThreadAlloc(wb_TaggedHeapThread* thread, wb_isize tag, int n = 1);
+
+template<typename T>
+WB_ALLOC_API 
+T* wb_taggedPoolRetrieve(wb_TaggedPool* pool);
+#endif
+
 
 /* TODO(will): Write per-function documentation */
 
@@ -463,6 +1401,85 @@ wb_MemoryPool* wb_poolFixedSizeBootstrap(
 		void* buffer, wb_usize size,
 		wb_iflags flags);
 
+/* poolDestroy frees the pool's occupancy bitmap, and, if the pool made its
+ * own arena (poolBootstrap), the arena too, which takes the pool with it. 
+ * Arenas you passed to poolInit are left for you to destroy.
+ */
+WB_ALLOC_API
+void wb_poolDestroy(wb_MemoryPool* pool);
+
+WB_ALLOC_API
+wb_isize wbi__ctz(wb_usize x);
+
+WB_ALLOC_API
+void wbi__poolGrowOccupancy(wb_MemoryPool* pool);
+
+WB_ALLOC_API
+void wbi__poolMarkRange(wb_MemoryPool* pool, wb_isize first, wb_isize count);
+
+WB_ALLOC_API
+wb_isize wbi__poolFindFree(wb_MemoryPool* pool);
+
+WB_ALLOC_API
+wb_isize wbi__poolRelist(wb_MemoryPool* pool);
+
+WB_ALLOC_API
+void wbi__poolSiftPointer(void** ptrs, wb_isize root, wb_isize end);
+
+WB_ALLOC_API
+void wbi__poolSortPointers(void** ptrs, wb_isize count);
+
+WB_ALLOC_API
+wb_isize wbi__releasePages(void* start, void* end, wb_MemoryInfo* info);
+
+WB_ALLOC_API
+wb_isize wbi__poolGrow(wb_MemoryPool* pool, wb_isize minCapacity);
+
+WB_ALLOC_API
+wb_isize wbi__arenaCommitTo(wb_MemoryArena* arena, void* newEnd);
+
+WB_ALLOC_API
+void* wbi__poolGetIndexLink(wb_MemoryPool* pool, void* slot);
+
+WB_ALLOC_API
+void wbi__poolSetIndexLink(wb_MemoryPool* pool, void* slot, void* next);
+
+/* NOTE(will): these are on the retrieve/release fast path, so plain pointer
+ * links stay inline behind a single flag test, and only index-linked pools
+ * make a call */
+#define wbi__poolGetLink(pool, slot) \
+	(((pool)->flags & (wb_Pool_IndexLinks | wb_Pool_ShortIndexLinks)) ? \
+	 wbi__poolGetIndexLink((pool), (slot)) : *(void**)(slot))
+
+#define wbi__poolSetLink(pool, slot, next) \
+	(((pool)->flags & (wb_Pool_IndexLinks | wb_Pool_ShortIndexLinks)) ? \
+	 wbi__poolSetIndexLink((pool), (slot), (next)) : \
+	 (void)(*(void**)(slot) = (void*)(next)))
+
+WB_ALLOC_API
+wb_isize wbi__poolMaxCapacity(wb_MemoryPool* pool);
+
+WB_ALLOC_API
+void wb_soaInit(wb_SoaPool* soa, wb_MemoryInfo info,
+		const wb_usize* fieldSizes, wb_isize fieldCount,
+		wb_iflags flags);
+
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info,
+		const wb_usize* fieldSizes, wb_isize fieldCount,
+		wb_iflags flags);
+
+WB_ALLOC_API
+void wb_soaDestroy(wb_SoaPool* soa);
+
+WB_ALLOC_API
+void wbi__soaInitColumns(wb_SoaPool* soa, wb_MemoryInfo info,
+		const wb_usize* fieldSizes, wb_isize fieldCount,
+		wb_iflags flags);
+
+WB_ALLOC_API
+wb_isize wbi__soaGrow(wb_SoaPool* soa, wb_isize minCapacity);
+
 
 WB_ALLOC_API wb_isize wb_calcTaggedHeapSize(
 		wb_isize arenaSize, wb_isize arenaCount, 
@@ -493,6 +1510,158 @@ void wbi__taggedArenaInit(wb_TaggedHeap* heap,
 WB_ALLOC_API 
 void wbi__taggedArenaSortBySize(wbi__TaggedHeapArena** array, wb_isize count);
 
+WB_ALLOC_API
+wb_isize wbi__atomicCas(volatile wb_usize* ptr, 
+		wb_usize oldValue, wb_usize newValue);
+
+WB_ALLOC_API
+wb_usize wbi__atomicAdd(volatile wb_usize* ptr, wb_usize n);
+
+WB_ALLOC_API
+void wbi__spinLock(volatile wb_usize* lock);
+
+WB_ALLOC_API
+void wbi__spinUnlock(volatile wb_usize* lock);
+
+WB_ALLOC_API
+wb_usize wbi__taggedDirtySize(wbi__TaggedHeapArena* block, wb_usize size);
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedAcquireBlock(wb_TaggedHeap* heap, 
+		wb_isize tag);
+
+WB_ALLOC_API
+void wbi__taggedReleaseBlocks(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapArena* first, wbi__TaggedHeapArena* last,
+		wb_isize count);
+
+WB_ALLOC_API
+wb_usize wbi__taggedClassStride(wb_TaggedHeap* heap, wb_isize sizeClass);
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedNextBlock(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wb_usize size);
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedReleaseClassBlocks(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapArena* first, wbi__TaggedHeapArena** last,
+		wb_isize* count);
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedSortBlocks(wbi__TaggedHeapArena* list);
+
+WB_ALLOC_API
+wb_isize wbi__taggedCoalesceClassBlocks(wb_TaggedHeap* heap);
+
+WB_ALLOC_API
+wb_isize wbi__taggedTrimBlocks(wb_TaggedHeap* heap, wb_isize keep);
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedPopBlock(wb_TaggedHeap* heap, 
+		volatile wb_usize* stack);
+
+WB_ALLOC_API
+void wbi__taggedPushBlocks(wb_TaggedHeap* heap, volatile wb_usize* stack,
+		wbi__TaggedHeapArena* first, wbi__TaggedHeapArena* last);
+
+WB_ALLOC_API
+void wbi__taggedLinkBlock(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wbi__TaggedHeapArena* block);
+
+WB_ALLOC_API
+wb_usize wbi__taggedHash(wb_isize tag);
+
+WB_ALLOC_API
+void wbi__taggedInitTag(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wb_isize tag);
+
+WB_ALLOC_API
+wbi__TaggedHeapTag* wbi__taggedDirectTag(wb_TaggedHeap* heap, wb_isize tag);
+
+WB_ALLOC_API
+wbi__TaggedHeapTag* wbi__taggedFindTag(wb_TaggedHeap* heap, 
+		wb_isize tag, wb_isize create);
+
+WB_ALLOC_API
+void wbi__taggedGrowBuckets(wb_TaggedHeap* heap);
+
+WB_ALLOC_API
+wb_isize wbi__taggedBinIndex(wb_usize space);
+
+WB_ALLOC_API
+void wbi__taggedBinBlock(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wbi__TaggedHeapArena* block);
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedFindFit(wbi__TaggedHeapTag* entry, 
+		wb_usize size);
+
+WB_ALLOC_API
+wb_isize wbi__taggedDetachTag(wb_TaggedHeap* heap, wb_isize tag, 
+		wbi__TaggedHeapTag* out);
+
+WB_ALLOC_API
+void wbi__taggedReleaseDetached(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* detached);
+
+WB_ALLOC_API
+void wbi__taggedSiftObject(wb_TaggedObject* objects, 
+		wb_isize root, wb_isize end);
+
+WB_ALLOC_API
+void wbi__taggedSortObjects(wb_TaggedObject* objects, wb_isize count);
+
+WB_ALLOC_API
+wb_isize wbi__taggedCountOwned(wbi__TaggedHeapArena* block, 
+		wb_TaggedObject* objects, wb_isize count);
+
+WB_ALLOC_API
+void wbi__taggedRewound(wbi__TaggedHeapTag* entry, 
+		wbi__TaggedHeapArena* block, void* head);
+
+WB_ALLOC_API
+void wbi__taggedPoolTrim(wb_TaggedPool* pool);
+
+WB_ALLOC_API
+void* wbi__taggedThreadAllocSlow(wb_TaggedHeapThread* thread, 
+		wb_isize tag, wb_usize size);
+
+WB_ALLOC_API
+void* wbi__taggedAllocLarge(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wb_usize size);
+
+WB_ALLOC_API
+void* wbi__taggedAllocEx(wb_TaggedHeap* heap, wbi__TaggedHeapTag* entry, 
+		wb_usize size, wb_usize align, WB_ALLOC_EXTENDED_INFO extended);
+
+WB_ALLOC_API
+void wbi__taggedTagStats(wbi__TaggedHeapTag* entry, wb_AllocStats* stats,
+		wb_isize countBlocks);
+
+#ifdef WB_ALLOC_STATS
+WB_ALLOC_API
+void wbi__poolStatRetrieve(wb_MemoryPool* pool, wb_isize n, wb_usize zeroed);
+
+WB_ALLOC_API
+void wbi__statPages(wb_AllocStats* stats, wb_isize released);
+#endif
+
+#ifdef WB_ALLOC_TRACE
+WB_ALLOC_API
+void wbi__traceRecord(wb_isize op, void* allocator, wb_usize value, 
+		wb_isize tag, wb_usize param, wb_iflags flags);
+
+WB_ALLOC_API
+void wbi__traceArena(wb_MemoryArena* arena, wb_isize op, wb_usize size);
+
+WB_ALLOC_API
+void wbi__tracePool(wb_MemoryPool* pool, wb_isize op, void* ptr);
+
+WB_ALLOC_API
+void wbi__traceTagged(wb_TaggedHeap* heap, wb_isize op, 
+		wb_isize tag, wb_usize size);
+#endif
+
 
 /* Platform-Specific Code */
 
@@ -848,6 +2017,29 @@ wb_isize wb_alignTo(wb_usize x, wb_usize align)
 	return mod ? x + (align - mod) : x;
 }
 
+WB_ALLOC_API
+wb_isize wbi__ctz(wb_usize x)
+{
+#if defined(WB_ALLOC_CTZ)
+	return WB_ALLOC_CTZ(x);
+#elif defined(_MSC_VER) && defined(_WIN64)
+	unsigned long index;
+	_BitScanForward64(&index, x);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, x);
+	return index;
+#else
+	wb_isize n = 0;
+	while(!(x & 1)) {
+		x >>= 1;
+		n++;
+	}
+	return n;
+#endif
+}
+
 /* Memory Arena */
 
 WB_ALLOC_API 
@@ -860,6 +2052,7 @@ void wb_arenaFixedSizeInit(wb_MemoryArena* arena,
 #endif
 
 	arena->name = "arena";
+	wbi__stat(WB_ALLOC_MEMSET(&arena->stats, 0, sizeof(wb_AllocStats)));
 
 	arena->flags = flags | wb_Arena_FixedSize;
 	arena->align = 8;
@@ -902,6 +2095,8 @@ void wb_arenaInit(wb_MemoryArena* arena, wb_MemoryInfo info, wb_iflags flags)
 				arena, arena->name);
 		return;
 	}
+	wbi__stat(WB_ALLOC_MEMSET(&arena->stats, 0, sizeof(wb_AllocStats)));
+	wbi__stat(arena->stats.commits++);
 	arena->head = arena->start;
 	arena->end = (char*)arena->start + info.commitSize;
 	arena->tempStart = NULL;
@@ -916,6 +2111,7 @@ void* wb_arenaPushEx(wb_MemoryArena* arena, wb_isize size,
 	void *oldHead, *ret;
 	wb_usize newHead, toExpand;
 
+	wbi__traced(wbi__traceArena(arena, wb_Trace_ArenaPush, size));
 	if(arena->flags & wb_Arena_Stack) {
 		size += sizeof(WB_ALLOC_STACK_PTR);
 	}
@@ -943,8 +2139,18 @@ void* wb_arenaPushEx(wb_MemoryArena* arena, wb_isize size,
 			return NULL;
 		}
 		arena->end = (char*)arena->end + toExpand;
+		wbi__stat(arena->stats.commits++);
 	}
 
+#ifdef WB_ALLOC_STATS
+	arena->stats.allocs++;
+	arena->stats.bytes += size;
+	arena->stats.alignWaste += newHead - ((wb_usize)arena->head + size);
+	if(newHead - (wb_usize)arena->start > arena->stats.highWater) {
+		arena->stats.highWater = newHead - (wb_usize)arena->start;
+	}
+#endif
+
 	if(arena->flags & wb_Arena_Stack) {
 		WB_ALLOC_STACK_PTR* head;
 		head = (WB_ALLOC_STACK_PTR*)newHead;
@@ -985,6 +2191,7 @@ void wb_arenaPop(wb_MemoryArena* arena)
 		return;
 	}
 #endif
+	wbi__traced(wbi__traceArena(arena, wb_Trace_ArenaPop, 0));
 
 	
 	prevHeadPtr = (wb_isize)arena->head - sizeof(WB_ALLOC_STACK_PTR);
@@ -999,9 +2206,11 @@ void wb_arenaPop(wb_MemoryArena* arena)
 		size = (wb_isize)arena->head - (wb_isize)newHead;
 		if(size > 0) {
 			WB_ALLOC_MEMSET(newHead, 0, size);
+			wbi__stat(arena->stats.zeroedBytes += size);
 		}
 	}
 
+	wbi__stat(arena->stats.frees++);
 	arena->head = newHead;
 }
 
@@ -1019,7 +2228,9 @@ wb_MemoryArena* wb_arenaBootstrap(wb_MemoryInfo info, wb_iflags flags)
 	}
 #endif
 
-	wb_arenaInit(&arena, info, flags);
+	/* NOTE(will): the setup pushes aren't traced; replaying the bootstrap 
+	 * does them again */
+	wb_arenaInit(&arena, info, flags & ~wb_Arena_Trace);
 	strapped = (wb_MemoryArena*)
 		wb_arenaPush(&arena, sizeof(wb_MemoryArena) + 16);
 	*strapped = arena;
@@ -1028,6 +2239,7 @@ wb_MemoryArena* wb_arenaBootstrap(wb_MemoryInfo info, wb_iflags flags)
 		*((WB_ALLOC_STACK_PTR*)(strapped->head) - 1) = 
 			(WB_ALLOC_STACK_PTR)strapped->head;
 	}
+	strapped->flags = flags;
 	
 	return strapped;
 }
@@ -1037,7 +2249,8 @@ wb_MemoryArena* arenaFixedSizeBootstrap(void* buffer, wb_usize size,
 		wb_iflags flags)
 {
 	wb_MemoryArena arena, *strapped;
-	wb_arenaFixedSizeInit(&arena, buffer, size, flags | wb_Arena_FixedSize);
+	wb_arenaFixedSizeInit(&arena, buffer, size, 
+			(flags | wb_Arena_FixedSize) & ~wb_Arena_Trace);
 	strapped = (wb_MemoryArena*)
 		wb_arenaPush(&arena, sizeof(wb_MemoryArena) + 16);
 	*strapped = arena;
@@ -1046,6 +2259,7 @@ wb_MemoryArena* arenaFixedSizeBootstrap(void* buffer, wb_usize size,
 		*((WB_ALLOC_STACK_PTR*)(strapped->head) - 1) = 
 			(WB_ALLOC_STACK_PTR)strapped->head;
 	}
+	strapped->flags = flags | wb_Arena_FixedSize;
 	return strapped;
 }
 
@@ -1053,6 +2267,7 @@ WB_ALLOC_API
 void wb_arenaStartTemp(wb_MemoryArena* arena)
 {
 	if(arena->tempStart) return;
+	wbi__traced(wbi__traceArena(arena, wb_Trace_ArenaStartTemp, 0));
 	arena->tempStart = (void*)wb_alignTo((wb_isize)arena->head, 
 			arena->info.pageSize);
 	arena->tempHead = arena->head;
@@ -1064,6 +2279,7 @@ void wb_arenaEndTemp(wb_MemoryArena* arena)
 {
 	wb_isize size;
 	if(!arena->tempStart) return;
+	wbi__traced(wbi__traceArena(arena, wb_Trace_ArenaEndTemp, 0));
 	arena->head = (void*)wb_alignTo((wb_isize)arena->head, arena->info.pageSize);
 	size = (wb_isize)arena->head - (wb_isize)arena->tempStart;
 
@@ -1074,9 +2290,11 @@ void wb_arenaEndTemp(wb_MemoryArena* arena)
 	if(!(arena->flags & wb_Arena_NoRecommit)) {
 		wbi__decommitMemory(arena->tempStart, size);
 		wbi__commitMemory(arena->tempStart, size, arena->info.commitFlags);
+		wbi__stat(wbi__statPages(&arena->stats, size));
 	} else if(!(arena->flags & wb_Arena_NoZeroMemory)) {
 		WB_ALLOC_MEMSET(arena->tempStart, 0,
 				(wb_isize)arena->head - (wb_isize)arena->tempStart);
+		wbi__stat(arena->stats.zeroedBytes += size);
 	}
 
 	arena->head = arena->tempHead;
@@ -1089,8 +2307,10 @@ void wb_arenaClear(wb_MemoryArena* arena)
 {
 	wb_MemoryArena local = *arena;
 	wb_isize size = (wb_isize)arena->end - (wb_isize)arena->start;
+	wbi__traced(wbi__traceArena(arena, wb_Trace_ArenaClear, 0));
 	wbi__decommitMemory(local.start, size);
 	wbi__commitMemory(local.start, size, local.info.commitFlags);
+	wbi__stat(wbi__statPages(&local.stats, size));
 	*arena = local;
 }
 
@@ -1114,16 +2334,191 @@ void wb_poolInit(wb_MemoryPool* pool, wb_MemoryArena* alloc,
 	pool->alloc = alloc;
 	pool->flags = flags;
 	pool->name = "pool";
-	pool->elementSize = elementSize < sizeof(void*) ?
-		sizeof(void*) :
-		elementSize;
+	wbi__stat(WB_ALLOC_MEMSET(&pool->stats, 0, sizeof(wb_AllocStats)));
+	if(flags & wb_Pool_ShortIndexLinks) {
+		pool->elementSize = elementSize < sizeof(wb_u16) ? 
+			sizeof(wb_u16) : 
+			elementSize;
+	} else if(flags & wb_Pool_IndexLinks) {
+		pool->elementSize = elementSize < sizeof(wb_u32) ? 
+			sizeof(wb_u32) : 
+			elementSize;
+	} else {
+		pool->elementSize = elementSize < sizeof(void*) ?
+			sizeof(void*) :
+			elementSize;
+	}
 	pool->count = 0;
 	pool->lastFilled = -1;
 	pool->capacity = (wb_isize)
-		((char*)alloc->end - (char*)alloc->head) / elementSize;
+		((char*)alloc->end - (char*)alloc->head) / pool->elementSize;
 
 	pool->slots = alloc->head;
 	pool->freeList = NULL;
+
+	if(flags & wb_Pool_PageSlots) {
+		if(flags & (wb_Pool_FixedSize | wb_Pool_Compacting)) {
+			WB_ALLOC_ERROR_HANDLER("PoolPageSlots doesn't work with "
+					"PoolFixedSize or PoolCompacting", 
+					pool, pool->name);
+			flags &= ~wb_Pool_PageSlots;
+			pool->flags = flags;
+		} else {
+			flags |= wb_Pool_TrackOccupancy;
+			pool->flags = flags;
+			pool->elementSize = wb_alignTo(pool->elementSize, 
+					alloc->info.pageSize);
+			wb_arenaPush(alloc, wb_alignTo((wb_isize)alloc->head, 
+						alloc->info.pageSize) - (wb_isize)alloc->head);
+			pool->slots = alloc->head;
+			pool->capacity = (wb_isize)
+				((char*)alloc->end - (char*)pool->slots) / pool->elementSize;
+		}
+	}
+
+	if(pool->capacity > wbi__poolMaxCapacity(pool)) {
+		pool->capacity = wbi__poolMaxCapacity(pool);
+	}
+
+	if(flags & wb_Pool_TrackOccupancy) {
+		if(flags & wb_Pool_Compacting) {
+			pool->flags &= ~wb_Pool_TrackOccupancy;
+		} else if(flags & wb_Pool_FixedSize) {
+			/* NOTE(will): there's nowhere else to put it, so the bitmap 
+			 * comes out of the front of the buffer and the slots go after */
+			wb_isize bits, words, avail;
+			bits = sizeof(wb_usize) * 8;
+			avail = (wb_isize)alloc->end - (wb_isize)alloc->head;
+			pool->capacity = avail * 8 / (pool->elementSize * 8 + 1);
+			words = (pool->capacity + bits - 1) / bits;
+			while(pool->capacity > 0 && (wb_isize)wb_alignTo(
+						words * sizeof(wb_usize), alloc->align) + 
+					pool->capacity * (wb_isize)pool->elementSize > avail) {
+				pool->capacity--;
+				words = (pool->capacity + bits - 1) / bits;
+			}
+			if(pool->capacity > wbi__poolMaxCapacity(pool)) {
+				pool->capacity = wbi__poolMaxCapacity(pool);
+				words = (pool->capacity + bits - 1) / bits;
+			}
+			pool->occupancy = (wb_usize*)wb_arenaPush(alloc, 
+					words * sizeof(wb_usize));
+			WB_ALLOC_MEMSET(pool->occupancy, 0, words * sizeof(wb_usize));
+			pool->occupancyWords = words;
+			pool->slots = alloc->head;
+		} else {
+			wb_MemoryInfo info = alloc->info;
+			info.totalMemory = wb_alignTo(
+					info.totalMemory / (pool->elementSize * 8) + 
+					info.pageSize * 4, info.pageSize);
+			info.commitSize = info.pageSize;
+			pool->occupancyAlloc = wb_arenaBootstrap(info, wb_Arena_Normal);
+			pool->occupancy = (wb_usize*)pool->occupancyAlloc->head;
+			pool->occupancyWords = 0;
+			wbi__poolGrowOccupancy(pool);
+		}
+	}
+}
+
+WB_ALLOC_API
+void wbi__poolGrowOccupancy(wb_MemoryPool* pool)
+{
+	wb_isize bits, words;
+	bits = sizeof(wb_usize) * 8;
+	words = (pool->capacity + bits - 1) / bits;
+	if(words <= pool->occupancyWords) return;
+
+	/* Nothing else gets pushed onto this arena, so the bitmap stays 
+	 * contiguous, and it's fresh memory, so it's already zeroed */
+	wb_arenaPush(pool->occupancyAlloc, 
+			(words - pool->occupancyWords) * sizeof(wb_usize));
+	pool->occupancyWords = words;
+}
+
+WB_ALLOC_API
+void wbi__poolMarkRange(wb_MemoryPool* pool, wb_isize first, wb_isize count)
+{
+	wb_isize bits, bit, n;
+	wb_usize mask;
+	bits = sizeof(wb_usize) * 8;
+	while(count > 0) {
+		bit = first % bits;
+		n = bits - bit;
+		if(n > count) n = count;
+		mask = n == bits ? ~(wb_usize)0 : (((wb_usize)1 << n) - 1) << bit;
+		pool->occupancy[first / bits] |= mask;
+		first += n;
+		count -= n;
+	}
+}
+
+WB_ALLOC_API
+wb_isize wbi__poolFindFree(wb_MemoryPool* pool)
+{
+	wb_isize bits, word, last, used;
+	wb_usize free;
+	bits = sizeof(wb_usize) * 8;
+	last = pool->lastFilled / bits;
+
+	for(word = pool->freeHint; word <= last; ++word) {
+		free = ~pool->occupancy[word];
+		if(word == last) {
+			used = pool->lastFilled % bits + 1;
+			if(used < bits) {
+				free &= ((wb_usize)1 << used) - 1;
+			}
+		}
+		if(free) {
+			pool->freeHint = word;
+			return word * bits + wbi__ctz(free);
+		}
+	}
+	pool->freeHint = word;
+	return -1;
+}
+
+WB_ALLOC_API
+wb_isize wbi__poolRelist(wb_MemoryPool* pool)
+{
+	/* NOTE(will): this only ever runs when the free list is empty, which 
+	 * means every free slot below lastFilled is one we dropped on purpose */
+	wb_isize bits, word, index, n;
+	wb_usize free;
+	void *slot, *prev;
+
+	index = wbi__poolFindFree(pool);
+	if(index < 0) {
+		pool->unlisted = 0;
+		return 0;
+	}
+
+	bits = sizeof(wb_usize) * 8;
+	word = index / bits;
+	free = ~pool->occupancy[word];
+	if(word == pool->lastFilled / bits && 
+			pool->lastFilled % bits + 1 < bits) {
+		free &= ((wb_usize)1 << (pool->lastFilled % bits + 1)) - 1;
+	}
+
+	n = 0;
+	prev = NULL;
+	while(free) {
+		index = word * bits + wbi__ctz(free);
+		free &= free - 1;
+		slot = (char*)pool->slots + index * pool->elementSize;
+		wbi__poolSetLink(pool, slot, NULL);
+		if(prev) {
+			wbi__poolSetLink(pool, prev, slot);
+		} else {
+			pool->freeList = (void**)slot;
+		}
+		prev = slot;
+		n++;
+	}
+
+	pool->freeHint = word + 1;
+	pool->unlisted -= n;
+	return n;
 }
 
 WB_ALLOC_API
@@ -1143,6 +2538,7 @@ wb_MemoryPool* wb_poolBootstrap(wb_MemoryInfo info,
 	pool = (wb_MemoryPool*)wb_arenaPush(alloc, sizeof(wb_MemoryPool));
 
 	wb_poolInit(pool, alloc, elementSize, flags);
+	pool->flags |= wbi__PoolOwnsArena;
 	return pool;
 }
 
@@ -1163,67 +2559,297 @@ wb_MemoryPool* wb_poolFixedSizeBootstrap(
 	return pool;
 }
 
-/* Utility functions not used
-wb_isize poolIndex(wb_MemoryPool* pool, void* ptr)
+WB_ALLOC_API
+void wb_poolDestroy(wb_MemoryPool* pool)
+{
+	if(pool->occupancyAlloc) {
+		wb_arenaDestroy(pool->occupancyAlloc);
+	}
+	/* NOTE(will): an arena handed to poolInit belongs to whoever made it */
+	if(pool->flags & wbi__PoolOwnsArena) {
+		wb_arenaDestroy(pool->alloc);
+	}
+}
+
+WB_ALLOC_API
+wb_isize wb_poolIndex(wb_MemoryPool* pool, void* ptr)
 {
 	wb_isize diff = (wb_isize)ptr - (wb_isize)pool->slots;
-	return diff / pool->elementSize;
+	return diff / (wb_isize)pool->elementSize;
 }
-void* poolFromIndex(wb_MemoryPool* pool, wb_isize index)
+
+WB_ALLOC_API
+void* wb_poolFromIndex(wb_MemoryPool* pool, wb_isize index)
 {
 	return (char*)pool->slots + index * pool->elementSize;
 }
-*/
 
 WB_ALLOC_API
-void* wb_poolRetrieve(wb_MemoryPool* pool)
+wb_isize wbi__poolMaxCapacity(wb_MemoryPool* pool)
 {
-	void *ptr, *ret;
-	ptr = NULL;
-	if((!(pool->flags & wb_Pool_Compacting)) && pool->freeList) {
-		ptr = pool->freeList;
-		pool->freeList = (void**)*pool->freeList;
-		pool->count++;
-
-		if(!(pool->flags & wb_Pool_NoZeroMemory)) {
-			WB_ALLOC_MEMSET(ptr, 0, pool->elementSize);
-		}
-
-		return ptr;
-	} 
-
-	if(pool->lastFilled >= pool->capacity - 1) {
-		if(pool->flags & wb_Pool_FixedSize) {
-			WB_ALLOC_ERROR_HANDLER("pool ran out of memory",
-					pool, pool->name);
-			return NULL;
-		}
-
-		ret = wb_arenaPush(pool->alloc, pool->alloc->info.commitSize);
-		if(!ret) {
-			WB_ALLOC_ERROR_HANDLER("arenaPush failed in poolRetrieve", 
-					pool, pool->name);
-			return NULL;
-		}
-		pool->capacity = (wb_isize)
-			((char*)pool->alloc->end - (char*)pool->slots) / pool->elementSize;
+	/* Index links store index + 1, so that zero can mean "end of list" */
+	if(pool->flags & wb_Pool_ShortIndexLinks) {
+		return 0xFFFF;
+	} else if((pool->flags & wb_Pool_IndexLinks) && 
+			sizeof(wb_isize) > sizeof(wb_u32)) {
+		return (wb_isize)0x7FFFFFFF;
 	}
+	return ~(wb_usize)0 >> 1;
+}
 
-	ptr = (char*)pool->slots + ++pool->lastFilled * pool->elementSize;
-	pool->count++;
-	if(!(pool->flags & wb_Pool_NoZeroMemory)) {
-		WB_ALLOC_MEMSET(ptr, 0, pool->elementSize);
+WB_ALLOC_API
+void* wbi__poolGetIndexLink(wb_MemoryPool* pool, void* slot)
+{
+	/* NOTE(will): index-linked slots can be any size, so the links might 
+	 * not be aligned; memcpy sorts that out (and is just a load anyway) */
+	wb_usize index;
+	if(pool->flags & wb_Pool_ShortIndexLinks) {
+		wb_u16 link;
+		WB_ALLOC_MEMCPY(&link, slot, sizeof(link));
+		index = link;
+	} else {
+		wb_u32 link;
+		WB_ALLOC_MEMCPY(&link, slot, sizeof(link));
+		index = link;
 	}
-	return ptr;
+	return index ? 
+		(char*)pool->slots + (index - 1) * pool->elementSize : 
+		NULL;
 }
 
 WB_ALLOC_API
-void wb_poolRelease(wb_MemoryPool* pool, void* ptr)
+void wbi__poolSetIndexLink(wb_MemoryPool* pool, void* slot, void* next)
 {
-	pool->count--;
-
-	if(pool->freeList && !(pool->flags & wb_Pool_NoDoubleFreeCheck)) {
-		void** localList = pool->freeList;
+	if(pool->flags & wb_Pool_ShortIndexLinks) {
+		wb_u16 link = (wb_u16)(next ? wb_poolIndex(pool, next) + 1 : 0);
+		WB_ALLOC_MEMCPY(slot, &link, sizeof(link));
+	} else {
+		wb_u32 link = (wb_u32)(next ? wb_poolIndex(pool, next) + 1 : 0);
+		WB_ALLOC_MEMCPY(slot, &link, sizeof(link));
+	}
+}
+
+WB_ALLOC_API
+wb_isize wbi__arenaCommitTo(wb_MemoryArena* arena, void* newEnd)
+{
+	wb_isize size;
+	char* start;
+	void* ret;
+	if((wb_usize)newEnd <= (wb_usize)arena->end) return 1;
+
+	if(arena->flags & wb_Arena_FixedSize) {
+		WB_ALLOC_ERROR_HANDLER("ran out of memory", arena, arena->name);
+		return 0;
+	}
+
+	/* NOTE(will): commitSize isn't always a multiple of the page size, but
+	 * the OS committed the whole page end is on, so start at the next one */
+	start = (char*)wb_alignTo((wb_isize)arena->end, arena->info.pageSize);
+	size = wb_alignTo((wb_isize)newEnd, arena->info.pageSize) - 
+		(wb_isize)start;
+	if(size > 0) {
+		ret = wbi__commitMemory(start, size, arena->info.commitFlags);
+		if(!ret) {
+			WB_ALLOC_ERROR_HANDLER("failed to commit memory", 
+					arena, arena->name);
+			return 0;
+		}
+		wbi__stat(arena->stats.commits++);
+	}
+	arena->end = start + size;
+	return 1;
+}
+
+WB_ALLOC_API
+wb_isize wbi__poolGrow(wb_MemoryPool* pool, wb_isize minCapacity)
+{
+	wb_isize step, newCapacity;
+	char* newEnd;
+
+	if(pool->flags & wb_Pool_FixedSize) {
+		WB_ALLOC_ERROR_HANDLER("pool ran out of memory",
+				pool, pool->name);
+		return 0;
+	}
+
+	step = pool->growCount;
+	if(step <= 0) {
+		step = pool->alloc->info.commitSize / pool->elementSize;
+		if(step < 1) step = 1;
+	}
+
+	newCapacity = pool->capacity + step;
+	if((pool->flags & wb_Pool_GeometricGrowth) && 
+			newCapacity < pool->capacity * 2) {
+		newCapacity = pool->capacity * 2;
+	}
+	if(newCapacity < minCapacity) newCapacity = minCapacity;
+	if(newCapacity > wbi__poolMaxCapacity(pool)) {
+		newCapacity = wbi__poolMaxCapacity(pool);
+		if(newCapacity < minCapacity) {
+			WB_ALLOC_ERROR_HANDLER("pool ran out of indices",
+					pool, pool->name);
+			return 0;
+		}
+	}
+
+	/* NOTE(will): everything in the arena past slots belongs to the pool,
+	 * so rather than pushing, commit straight up to where we need to be */
+	newEnd = (char*)pool->slots + newCapacity * pool->elementSize;
+	if(!wbi__arenaCommitTo(pool->alloc, newEnd)) {
+		return 0;
+	}
+	if((wb_usize)pool->alloc->head < (wb_usize)pool->alloc->end) {
+		pool->alloc->head = pool->alloc->end;
+	}
+
+	pool->capacity = (wb_isize)
+		((char*)pool->alloc->end - (char*)pool->slots) / pool->elementSize;
+	if(pool->capacity > wbi__poolMaxCapacity(pool)) {
+		pool->capacity = wbi__poolMaxCapacity(pool);
+	}
+	if(pool->flags & wb_Pool_TrackOccupancy) {
+		wbi__poolGrowOccupancy(pool);
+	}
+	return 1;
+}
+
+WB_ALLOC_API
+wb_isize wb_poolReserve(wb_MemoryPool* pool, wb_isize count, wb_isize prefault)
+{
+	wb_isize freeBelow, tail;
+	char *start, *end;
+
+	freeBelow = 0;
+	if(!(pool->flags & wb_Pool_Compacting)) {
+		freeBelow = pool->lastFilled + 1 - pool->count;
+	}
+
+	tail = count - freeBelow;
+	if(tail <= 0) return 1;
+
+	if(pool->lastFilled + tail > pool->capacity - 1 &&
+			!wbi__poolGrow(pool, pool->lastFilled + 1 + tail)) {
+		return 0;
+	}
+
+	if(prefault) {
+		/* One write per page is enough to get the OS to map it; only 
+		 * unused slots get written to, so nothing live is disturbed */
+		start = (char*)pool->slots + (pool->lastFilled + 1) * pool->elementSize;
+		end = start + tail * pool->elementSize;
+		*(volatile char*)start = 0;
+		start = (char*)wb_alignTo((wb_isize)start + 1, 
+				pool->alloc->info.pageSize);
+		for(; start < end; start += pool->alloc->info.pageSize) {
+			*(volatile char*)start = 0;
+		}
+	}
+	return 1;
+}
+
+WB_ALLOC_API
+void* wb_poolRetrieve(wb_MemoryPool* pool)
+{
+	void *ptr;
+	wb_isize index;
+	ptr = NULL;
+
+	if(pool->flags & wb_Pool_PageSlots) {
+		/* Released page slots were recommitted, so they come back zeroed;
+		 * there's no free list, only the bitmap */
+		if(pool->unlisted > 0 && (index = wbi__poolFindFree(pool)) >= 0) {
+			pool->unlisted--;
+			pool->count++;
+			wbi__poolMarkRange(pool, index, 1);
+			wbi__stat(wbi__poolStatRetrieve(pool, 1, 0));
+			ptr = (char*)pool->slots + index * pool->elementSize;
+			wbi__traced(wbi__tracePool(pool, wb_Trace_PoolRetrieve, ptr));
+			return ptr;
+		}
+	} else if(!pool->freeList && pool->unlisted > 0) {
+		wbi__poolRelist(pool);
+	}
+
+	if((!(pool->flags & wb_Pool_Compacting)) && pool->freeList) {
+		ptr = pool->freeList;
+		pool->freeList = (void**)wbi__poolGetLink(pool, pool->freeList);
+		pool->count++;
+
+		if(!(pool->flags & wb_Pool_NoZeroMemory)) {
+			WB_ALLOC_MEMSET(ptr, 0, pool->elementSize);
+		}
+
+		if(pool->flags & wb_Pool_TrackOccupancy) {
+			wbi__poolMarkRange(pool, ((wb_isize)ptr - (wb_isize)pool->slots) /
+					(wb_isize)pool->elementSize, 1);
+		}
+
+		wbi__stat(wbi__poolStatRetrieve(pool, 1, 
+					(pool->flags & wb_Pool_NoZeroMemory) ? 0 : pool->elementSize));
+		wbi__traced(wbi__tracePool(pool, wb_Trace_PoolRetrieve, ptr));
+		return ptr;
+	} 
+
+	if(pool->lastFilled >= pool->capacity - 1 && 
+			!wbi__poolGrow(pool, pool->lastFilled + 2)) {
+		return NULL;
+	}
+
+	ptr = (char*)pool->slots + ++pool->lastFilled * pool->elementSize;
+	pool->count++;
+	if(!(pool->flags & (wb_Pool_NoZeroMemory | wb_Pool_PageSlots))) {
+		WB_ALLOC_MEMSET(ptr, 0, pool->elementSize);
+	}
+	if(pool->flags & wb_Pool_TrackOccupancy) {
+		wbi__poolMarkRange(pool, pool->lastFilled, 1);
+	}
+	wbi__stat(wbi__poolStatRetrieve(pool, 1, 
+				(pool->flags & (wb_Pool_NoZeroMemory | wb_Pool_PageSlots)) ? 
+				0 : pool->elementSize));
+	wbi__traced(wbi__tracePool(pool, wb_Trace_PoolRetrieve, ptr));
+	return ptr;
+}
+
+WB_ALLOC_API
+void wb_poolRelease(wb_MemoryPool* pool, void* ptr)
+{
+	wbi__traced(wbi__tracePool(pool, wb_Trace_PoolRelease, ptr));
+	pool->count--;
+
+	if(pool->flags & wb_Pool_TrackOccupancy) {
+		/* NOTE(will): with the bitmap around, the double free check is just
+		 * looking at a bit rather than walking the whole free list */
+		wb_isize index, bits;
+		wb_usize mask;
+		bits = sizeof(wb_usize) * 8;
+		index = ((wb_isize)ptr - (wb_isize)pool->slots) / 
+			(wb_isize)pool->elementSize;
+		mask = (wb_usize)1 << (index % bits);
+		if(!(pool->occupancy[index / bits] & mask)) {
+			pool->count++;
+			if(!(pool->flags & wb_Pool_NoDoubleFreeCheck)) {
+				WB_ALLOC_ERROR_HANDLER("caught attempting to free previously "
+						"freed memory in poolRelease", 
+						pool, pool->name);
+			}
+			return;
+		}
+		pool->occupancy[index / bits] &= ~mask;
+
+		if(pool->flags & wb_Pool_PageSlots) {
+			if(wbi__releasePages(ptr, (char*)ptr + pool->elementSize, 
+						&pool->alloc->info)) {
+				wbi__stat(wbi__statPages(&pool->stats, 1));
+			}
+			pool->unlisted++;
+			if(pool->freeHint > index / bits) {
+				pool->freeHint = index / bits;
+			}
+			return;
+		}
+	} else if(pool->freeList && !(pool->flags & wb_Pool_NoDoubleFreeCheck)) {
+		void** localList = pool->freeList;
 		do {
 			if(ptr == localList) {
 				WB_ALLOC_ERROR_HANDLER("caught attempting to free previously "
@@ -1231,204 +2857,3249 @@ void wb_poolRelease(wb_MemoryPool* pool, void* ptr)
 						pool, pool->name);
 				return;
 			}
-		} while((localList = (void**)*localList));
+		} while((localList = (void**)wbi__poolGetLink(pool, localList)));
+	}
+
+	if(pool->flags & wb_Pool_Compacting) {
+		WB_ALLOC_MEMCPY(ptr, 
+				(char*)pool->slots + pool->count * pool->elementSize,
+				pool->elementSize);
+		return;
+	}
+
+	wbi__poolSetLink(pool, ptr, pool->freeList);
+	pool->freeList = (void**)ptr;
+}
+
+WB_ALLOC_API
+wb_isize wb_poolRetrieveBatch(wb_MemoryPool* pool, void** out, wb_isize count)
+{
+	wb_isize n, run;
+	void *ptr;
+	n = 0;
+
+	if(pool->flags & wb_Pool_PageSlots) {
+		for(n = 0; n < count; ++n) {
+			if(!(out[n] = wb_poolRetrieve(pool))) break;
+		}
+		return n;
+	}
+
+	if(!(pool->flags & wb_Pool_Compacting)) {
+		while(n < count && (pool->freeList || 
+					(pool->unlisted > 0 && wbi__poolRelist(pool)))) {
+			ptr = pool->freeList;
+			pool->freeList = (void**)wbi__poolGetLink(pool, pool->freeList);
+			if(!(pool->flags & wb_Pool_NoZeroMemory)) {
+				WB_ALLOC_MEMSET(ptr, 0, pool->elementSize);
+			}
+			if(pool->flags & wb_Pool_TrackOccupancy) {
+				wbi__poolMarkRange(pool, ((wb_isize)ptr - (wb_isize)pool->slots) /
+						(wb_isize)pool->elementSize, 1);
+			}
+			wbi__traced(wbi__tracePool(pool, wb_Trace_PoolRetrieve, ptr));
+			out[n++] = ptr;
+		}
+	}
+
+	run = count - n;
+	if(run <= 0) {
+		pool->count += n;
+		wbi__stat(wbi__poolStatRetrieve(pool, n, 
+					(pool->flags & wb_Pool_NoZeroMemory) ? 0 : n * pool->elementSize));
+		return n;
+	}
+
+	if(pool->lastFilled + run > pool->capacity - 1) {
+		if(pool->flags & wb_Pool_FixedSize) {
+			WB_ALLOC_ERROR_HANDLER("pool ran out of memory in poolRetrieveBatch",
+					pool, pool->name);
+			run = pool->capacity - 1 - pool->lastFilled;
+		} else if(!wbi__poolGrow(pool, pool->lastFilled + 1 + run)) {
+			pool->count += n;
+			wbi__stat(wbi__poolStatRetrieve(pool, n, 
+						(pool->flags & wb_Pool_NoZeroMemory) ? 
+						0 : n * pool->elementSize));
+			return n;
+		}
+	}
+
+	ptr = (char*)pool->slots + (pool->lastFilled + 1) * pool->elementSize;
+	if(run > 0 && !(pool->flags & wb_Pool_NoZeroMemory)) {
+		WB_ALLOC_MEMSET(ptr, 0, run * pool->elementSize);
+	}
+	if(run > 0 && (pool->flags & wb_Pool_TrackOccupancy)) {
+		wbi__poolMarkRange(pool, pool->lastFilled + 1, run);
+	}
+	pool->lastFilled += run;
+
+	while(run-- > 0) {
+		wbi__traced(wbi__tracePool(pool, wb_Trace_PoolRetrieve, ptr));
+		out[n++] = ptr;
+		ptr = (char*)ptr + pool->elementSize;
+	}
+
+	pool->count += n;
+	wbi__stat(wbi__poolStatRetrieve(pool, n, 
+				(pool->flags & wb_Pool_NoZeroMemory) ? 0 : n * pool->elementSize));
+	return n;
+}
+
+WB_ALLOC_API
+void wbi__poolSiftPointer(void** ptrs, wb_isize root, wb_isize end)
+{
+	void* temp;
+	wb_isize child;
+	while((child = root * 2 + 1) < end) {
+		if(child + 1 < end && 
+				(wb_usize)ptrs[child] < (wb_usize)ptrs[child + 1]) {
+			child++;
+		}
+		if((wb_usize)ptrs[root] >= (wb_usize)ptrs[child]) break;
+		temp = ptrs[root];
+		ptrs[root] = ptrs[child];
+		ptrs[child] = temp;
+		root = child;
+	}
+}
+
+WB_ALLOC_API
+void wbi__poolSortPointers(void** ptrs, wb_isize count)
+{
+	void* temp;
+	wb_isize i;
+
+	/* NOTE(will): heapsort, so it's in place and we don't pull in qsort */
+	for(i = count / 2 - 1; i >= 0; --i) {
+		wbi__poolSiftPointer(ptrs, i, count);
+	}
+	for(i = count - 1; i > 0; --i) {
+		temp = ptrs[0];
+		ptrs[0] = ptrs[i];
+		ptrs[i] = temp;
+		wbi__poolSiftPointer(ptrs, 0, i);
+	}
+}
+
+WB_ALLOC_API
+void wb_poolReleaseBatch(wb_MemoryPool* pool, void** ptrs, wb_isize count)
+{
+	wb_isize i;
+	if(count <= 0) return;
+
+	if(pool->flags & (wb_Pool_Compacting | wb_Pool_PageSlots)) {
+		for(i = 0; i < count; ++i) {
+			wb_poolRelease(pool, ptrs[i]);
+		}
+		return;
+	}
+
+	if(pool->flags & wb_Pool_TrackOccupancy) {
+		/* NOTE(will): clearing the bits as we go catches the same pointer 
+		 * showing up twice in ptrs, too; if anything's wrong, the bits we 
+		 * already cleared get put back, and nothing is released */
+		wb_isize index, bits, j;
+		wb_usize mask;
+		bits = sizeof(wb_usize) * 8;
+		for(i = 0; i < count; ++i) {
+			index = ((wb_isize)ptrs[i] - (wb_isize)pool->slots) / 
+				(wb_isize)pool->elementSize;
+			mask = (wb_usize)1 << (index % bits);
+			if(!(pool->occupancy[index / bits] & mask)) {
+				if(!(pool->flags & wb_Pool_NoDoubleFreeCheck)) {
+					WB_ALLOC_ERROR_HANDLER("caught attempting to free previously "
+							"freed memory in poolReleaseBatch",
+							pool, pool->name);
+				}
+				for(j = 0; j < i; ++j) {
+					index = ((wb_isize)ptrs[j] - (wb_isize)pool->slots) / 
+						(wb_isize)pool->elementSize;
+					pool->occupancy[index / bits] |= 
+						(wb_usize)1 << (index % bits);
+				}
+				return;
+			}
+			pool->occupancy[index / bits] &= ~mask;
+		}
+	} else if(!(pool->flags & wb_Pool_NoDoubleFreeCheck)) {
+		/* NOTE(will): sorted, a pointer that's in the batch twice sits next
+		 * to itself, and each free list entry is a binary search away, so 
+		 * it's one pass over each instead of one per pointer */
+		void** localList;
+		wb_isize low, high, mid;
+		wbi__poolSortPointers(ptrs, count);
+		for(i = 1; i < count; ++i) {
+			if(ptrs[i] == ptrs[i - 1]) {
+				WB_ALLOC_ERROR_HANDLER("caught attempting to free the same "
+						"memory twice in poolReleaseBatch",
+						pool, pool->name);
+				return;
+			}
+		}
+		localList = pool->freeList;
+		while(localList) {
+			low = 0;
+			high = count - 1;
+			while(low <= high) {
+				mid = low + (high - low) / 2;
+				if(ptrs[mid] == (void*)localList) {
+					WB_ALLOC_ERROR_HANDLER("caught attempting to free "
+							"previously freed memory in poolReleaseBatch",
+							pool, pool->name);
+					return;
+				} else if((wb_usize)ptrs[mid] < (wb_usize)localList) {
+					low = mid + 1;
+				} else {
+					high = mid - 1;
+				}
+			}
+			localList = (void**)wbi__poolGetLink(pool, localList);
+		}
+	}
+
+#ifdef WB_ALLOC_TRACE
+	for(i = 0; i < count; ++i) {
+		wbi__tracePool(pool, wb_Trace_PoolRelease, ptrs[i]);
+	}
+#endif
+	for(i = 0; i < count - 1; ++i) {
+		wbi__poolSetLink(pool, ptrs[i], ptrs[i + 1]);
+	}
+	wbi__poolSetLink(pool, ptrs[count - 1], pool->freeList);
+	pool->freeList = (void**)ptrs[0];
+	pool->count -= count;
+}
+
+WB_ALLOC_API
+void wb_poolIterBegin(wb_MemoryPool* pool, wb_PoolIterator* iter)
+{
+	wb_isize bits = sizeof(wb_usize) * 8;
+	iter->pool = pool;
+	iter->word = 0;
+
+	if(pool->flags & wb_Pool_Compacting) {
+		iter->index = -1;
+		iter->end = pool->count;
+		return;
+	}
+
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(!(pool->flags & wb_Pool_TrackOccupancy)) {
+		WB_ALLOC_ERROR_HANDLER(
+				"can't iterate a pool without PoolTrackOccupancy or "
+				"PoolCompacting",
+				pool, pool->name);
+		iter->index = 0;
+		iter->end = 0;
+		return;
+	}
+#endif
+
+	/* index is the current word of the bitmap, and word is the bits in it
+	 * that we haven't handed out yet */
+	iter->index = -1;
+	iter->end = (pool->lastFilled + bits) / bits;
+}
+
+WB_ALLOC_API
+void* wb_poolIterNext(wb_PoolIterator* iter)
+{
+	wb_MemoryPool* pool = iter->pool;
+	wb_isize bits, slot;
+	char* ptr;
+
+	if(pool->flags & wb_Pool_Compacting) {
+		if(++iter->index >= iter->end) return NULL;
+		ptr = (char*)pool->slots + iter->index * pool->elementSize;
+		WB_ALLOC_PREFETCH(ptr + WB_ALLOC_POOL_PREFETCH_DISTANCE * 
+				pool->elementSize);
+		return ptr;
+	}
+
+	while(!iter->word) {
+		if(++iter->index >= iter->end) {
+			iter->index = iter->end;
+			return NULL;
+		}
+		iter->word = pool->occupancy[iter->index];
+	}
+
+	bits = sizeof(wb_usize) * 8;
+	slot = iter->index * bits + wbi__ctz(iter->word);
+	iter->word &= iter->word - 1;
+
+	ptr = (char*)pool->slots + slot * pool->elementSize;
+	WB_ALLOC_PREFETCH(ptr + WB_ALLOC_POOL_PREFETCH_DISTANCE * pool->elementSize);
+	return ptr;
+}
+
+WB_ALLOC_API
+wb_isize wb_poolDefragment(wb_MemoryPool* pool, 
+		wb_PoolRelocateProc relocate, void* userdata,
+		wb_isize maxMoves)
+{
+	wb_isize bits, moves, to;
+	void *src, *dest;
+
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(!(pool->flags & wb_Pool_TrackOccupancy)) {
+		WB_ALLOC_ERROR_HANDLER(
+				"can't defragment a pool without PoolTrackOccupancy",
+				pool, pool->name);
+		return 0;
+	}
+#endif
+
+	/* Forget the free list; everything free is found through the bitmap
+	 * from here on, which is what lets us pick the lowest slots */
+	bits = sizeof(wb_usize) * 8;
+	pool->freeList = NULL;
+	pool->freeHint = 0;
+	pool->unlisted = pool->lastFilled + 1 - pool->count;
+
+#define wbi__poolIsLive(pool, i) \
+	((pool)->occupancy[(i) / bits] & ((wb_usize)1 << ((i) % bits)))
+
+	moves = 0;
+	for(;;) {
+		while(pool->lastFilled >= 0 && !wbi__poolIsLive(pool, pool->lastFilled)) {
+			pool->lastFilled--;
+			pool->unlisted--;
+		}
+
+		if(pool->unlisted <= 0 || moves >= maxMoves) break;
+
+		to = wbi__poolFindFree(pool);
+		if(to < 0 || to >= pool->lastFilled) break;
+
+		src = (char*)pool->slots + pool->lastFilled * pool->elementSize;
+		dest = (char*)pool->slots + to * pool->elementSize;
+		WB_ALLOC_MEMCPY(dest, src, pool->elementSize);
+		wbi__poolMarkRange(pool, to, 1);
+		pool->occupancy[pool->lastFilled / bits] &= 
+			~((wb_usize)1 << (pool->lastFilled % bits));
+		pool->lastFilled--;
+		pool->unlisted--;
+		moves++;
+
+		if(relocate) {
+			relocate(userdata, src, dest);
+		}
+
+		if(pool->flags & wb_Pool_PageSlots) {
+			wbi__releasePages(src, (char*)src + pool->elementSize, 
+					&pool->alloc->info);
+		}
+	}
+
+#undef wbi__poolIsLive
+
+	if(pool->unlisted < 0) pool->unlisted = 0;
+	pool->freeHint = 0;
+	return pool->unlisted;
+}
+
+WB_ALLOC_API
+void wb_poolSortFreeList(wb_MemoryPool* pool)
+{
+	wb_isize width, merges, psize, qsize, i;
+	void *list, *p, *q, *e, *tail;
+
+	if(pool->flags & wb_Pool_Compacting) return;
+
+	if(pool->flags & wb_Pool_TrackOccupancy) {
+		pool->freeList = NULL;
+		pool->freeHint = 0;
+		pool->unlisted = pool->lastFilled + 1 - pool->count;
+		return;
+	}
+
+	/* Bottom-up merge sort, so we don't need anything but the links */
+	list = pool->freeList;
+	for(width = 1; list; width *= 2) {
+		p = list;
+		list = NULL;
+		tail = NULL;
+		merges = 0;
+
+		while(p) {
+			merges++;
+			q = p;
+			psize = 0;
+			for(i = 0; i < width && q; ++i) {
+				psize++;
+				q = wbi__poolGetLink(pool, q);
+			}
+			qsize = width;
+
+			while(psize > 0 || (qsize > 0 && q)) {
+				if(psize == 0) {
+					e = q; q = wbi__poolGetLink(pool, q); qsize--;
+				} else if(qsize == 0 || !q) {
+					e = p; p = wbi__poolGetLink(pool, p); psize--;
+				} else if((wb_usize)p <= (wb_usize)q) {
+					e = p; p = wbi__poolGetLink(pool, p); psize--;
+				} else {
+					e = q; q = wbi__poolGetLink(pool, q); qsize--;
+				}
+				if(tail) {
+					wbi__poolSetLink(pool, tail, e);
+				} else {
+					list = e;
+				}
+				tail = e;
+			}
+			p = q;
+		}
+		if(tail) {
+			wbi__poolSetLink(pool, tail, NULL);
+		}
+
+		if(merges <= 1) break;
+	}
+
+	pool->freeList = (void**)list;
+}
+
+WB_ALLOC_API
+wb_isize wbi__releasePages(void* start, void* end, wb_MemoryInfo* info)
+{
+	/* Only whole pages inside [start, end) go back; decommitting then 
+	 * recommitting drops the physical pages and hands back zeroed ones */
+	wb_isize first, last;
+	first = wb_alignTo((wb_isize)start, info->pageSize);
+	last = (wb_isize)end & ~(wb_isize)(info->pageSize - 1);
+	if(last <= first) return 0;
+
+	wbi__decommitMemory((void*)first, last - first);
+	wbi__commitMemory((void*)first, last - first, info->commitFlags);
+	return last - first;
+}
+
+WB_ALLOC_API
+wb_isize wb_poolTrim(wb_MemoryPool* pool)
+{
+	wb_isize bits, i, runStart, run, released;
+	wb_usize word;
+	char* slots;
+
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(!(pool->flags & wb_Pool_TrackOccupancy)) {
+		WB_ALLOC_ERROR_HANDLER(
+				"can't trim a pool without PoolTrackOccupancy",
+				pool, pool->name);
+		return 0;
+	}
+#endif
+
+	bits = sizeof(wb_usize) * 8;
+	pool->freeList = NULL;
+	pool->freeHint = 0;
+	pool->unlisted = pool->lastFilled + 1 - pool->count;
+
+	while(pool->lastFilled >= 0 && !(pool->occupancy[pool->lastFilled / bits] &
+				((wb_usize)1 << (pool->lastFilled % bits)))) {
+		pool->lastFilled--;
+		pool->unlisted--;
+	}
+
+	if((pool->flags & wb_Pool_FixedSize) || !pool->alloc->info.pageSize) {
+		return 0;
+	}
+
+	slots = (char*)pool->slots;
+	released = wbi__releasePages(
+			slots + (pool->lastFilled + 1) * pool->elementSize,
+			pool->alloc->end, &pool->alloc->info);
+	wbi__stat(wbi__statPages(&pool->stats, released));
+
+	/* Walk the runs of free slots below lastFilled; skipping full words 
+	 * keeps this cheap when the pool is mostly dense */
+	runStart = -1;
+	for(i = 0; i <= pool->lastFilled; ++i) {
+		word = pool->occupancy[i / bits];
+		if(i % bits == 0 && runStart < 0 && word == ~(wb_usize)0) {
+			i += bits - 1;
+			continue;
+		}
+
+		if(word & ((wb_usize)1 << (i % bits))) {
+			if(runStart >= 0) {
+				run = wbi__releasePages(
+						slots + runStart * pool->elementSize,
+						slots + i * pool->elementSize,
+						&pool->alloc->info);
+				wbi__stat(wbi__statPages(&pool->stats, run));
+				released += run;
+				runStart = -1;
+			}
+		} else if(runStart < 0) {
+			runStart = i;
+		}
+	}
+
+	return released;
+}
+
+/* Structure-of-arrays Pool */
+WB_ALLOC_API
+void wbi__soaInitColumns(wb_SoaPool* soa, wb_MemoryInfo info,
+		const wb_usize* fieldSizes, wb_isize fieldCount,
+		wb_iflags flags)
+{
+	wb_isize i;
+	wb_usize elementSize, offset;
+	char* base;
+
+	soa->name = "soaPool";
+	soa->info = info;
+	soa->flags = flags;
+	soa->capacity = 0;
+
+	if(fieldCount > WB_ALLOC_SOA_MAX_FIELDS) {
+		WB_ALLOC_ERROR_HANDLER("too many fields for a soaPool; "
+				"redefine WB_ALLOC_SOA_MAX_FIELDS",
+				soa, soa->name);
+		fieldCount = WB_ALLOC_SOA_MAX_FIELDS;
+	}
+	soa->fieldCount = fieldCount;
+
+	elementSize = 0;
+	for(i = 0; i < fieldCount; ++i) {
+		soa->fieldSizes[i] = fieldSizes[i];
+		elementSize += fieldSizes[i];
+	}
+	if(elementSize == 0) elementSize = 1;
+
+	/* NOTE(will): like everything else here, this reserves about as much
+	 * as the machine has, split between the columns by field size */
+	soa->maxCapacity = info.totalMemory / elementSize;
+	soa->reservationSize = 0;
+	for(i = 0; i < fieldCount; ++i) {
+		soa->reservationSize += wb_alignTo(
+				soa->maxCapacity * fieldSizes[i], info.pageSize);
+	}
+
+	soa->reservation = wbi__allocateVirtualSpace(soa->reservationSize);
+	if(!soa->reservation) {
+		WB_ALLOC_ERROR_HANDLER("failed to reserve space for soaPool columns",
+				soa, soa->name);
+		return;
+	}
+
+	base = (char*)soa->reservation;
+	offset = 0;
+	for(i = 0; i < fieldCount; ++i) {
+		soa->columns[i] = base + offset;
+		offset += wb_alignTo(soa->maxCapacity * fieldSizes[i], info.pageSize);
+	}
+}
+
+WB_ALLOC_API
+void wb_soaInit(wb_SoaPool* soa, wb_MemoryInfo info,
+		const wb_usize* fieldSizes, wb_isize fieldCount,
+		wb_iflags flags)
+{
+#ifndef WB_ALLOC_NO_ZERO_ON_INIT
+	WB_ALLOC_MEMSET(soa, 0, sizeof(wb_SoaPool));
+#endif
+
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(flags & (wb_Pool_FixedSize | wb_Pool_Compacting)) {
+		WB_ALLOC_ERROR_HANDLER(
+				"soaPools can't be fixed-size or compacting",
+				soa, "soaPool");
+		flags &= ~(wb_Pool_FixedSize | wb_Pool_Compacting);
+	}
+#endif
+
+	/* The index pool never needs zeroing; the columns get zeroed instead */
+	soa->indices = wb_poolBootstrap(info, sizeof(wb_u32), 
+			flags | wb_Pool_NoZeroMemory | wb_Pool_IndexLinks);
+	wbi__soaInitColumns(soa, info, fieldSizes, fieldCount, flags);
+}
+
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info,
+		const wb_usize* fieldSizes, wb_isize fieldCount,
+		wb_iflags flags)
+{
+	wb_MemoryArena* alloc;
+	wb_SoaPool* soa;
+	wb_MemoryPool* indices;
+
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(flags & (wb_Pool_FixedSize | wb_Pool_Compacting)) {
+		WB_ALLOC_ERROR_HANDLER(
+				"soaPools can't be fixed-size or compacting",
+				NULL, "soaPool");
+		flags &= ~(wb_Pool_FixedSize | wb_Pool_Compacting);
+	}
+#endif
+
+	alloc = wb_arenaBootstrap(info, wb_Arena_Normal);
+	soa = (wb_SoaPool*)wb_arenaPush(alloc, sizeof(wb_SoaPool));
+	indices = (wb_MemoryPool*)wb_arenaPush(alloc, sizeof(wb_MemoryPool));
+	wb_poolInit(indices, alloc, sizeof(wb_u32), 
+			flags | wb_Pool_NoZeroMemory | wb_Pool_IndexLinks);
+	indices->flags |= wbi__PoolOwnsArena;
+
+#ifndef WB_ALLOC_NO_ZERO_ON_INIT
+	WB_ALLOC_MEMSET(soa, 0, sizeof(wb_SoaPool));
+#endif
+	soa->indices = indices;
+	wbi__soaInitColumns(soa, info, fieldSizes, fieldCount, flags);
+	return soa;
+}
+
+WB_ALLOC_API
+void wb_soaDestroy(wb_SoaPool* soa)
+{
+	if(soa->reservation) {
+		wbi__freeAddressSpace(soa->reservation, soa->reservationSize);
+	}
+	/* If we were bootstrapped, this takes soa with it */
+	wb_poolDestroy(soa->indices);
+}
+
+WB_ALLOC_API
+wb_isize wbi__soaGrow(wb_SoaPool* soa, wb_isize minCapacity)
+{
+	wb_isize i, newCapacity;
+	wb_usize oldEnd, newEnd;
+	void* ret;
+
+	if(minCapacity > soa->maxCapacity) {
+		WB_ALLOC_ERROR_HANDLER("soaPool ran out of reserved space",
+				soa, soa->name);
+		return 0;
+	}
+
+	/* Grow by at least a page worth of elements, so that the smallest 
+	 * column commits a whole page at a time */
+	newCapacity = soa->capacity * 2;
+	if(newCapacity < minCapacity) newCapacity = minCapacity;
+	newCapacity = wb_alignTo(newCapacity, soa->info.pageSize);
+	if(newCapacity > soa->maxCapacity) newCapacity = soa->maxCapacity;
+
+	for(i = 0; i < soa->fieldCount; ++i) {
+		oldEnd = wb_alignTo(soa->capacity * soa->fieldSizes[i], 
+				soa->info.pageSize);
+		newEnd = wb_alignTo(newCapacity * soa->fieldSizes[i], 
+				soa->info.pageSize);
+		if(newEnd <= oldEnd) continue;
+		ret = wbi__commitMemory((char*)soa->columns[i] + oldEnd, 
+				newEnd - oldEnd, soa->info.commitFlags);
+		if(!ret) {
+			WB_ALLOC_ERROR_HANDLER("failed to commit memory in soaRetrieve",
+					soa, soa->name);
+			return 0;
+		}
+	}
+
+	soa->capacity = newCapacity;
+	return 1;
+}
+
+WB_ALLOC_API
+wb_isize wb_soaRetrieve(wb_SoaPool* soa)
+{
+	wb_isize index, i;
+	void* slot;
+
+	slot = wb_poolRetrieve(soa->indices);
+	if(!slot) return -1;
+	index = ((wb_isize)slot - (wb_isize)soa->indices->slots) / 
+		(wb_isize)soa->indices->elementSize;
+
+	if(index >= soa->capacity && !wbi__soaGrow(soa, index + 1)) {
+		wb_poolRelease(soa->indices, slot);
+		return -1;
+	}
+
+	if(!(soa->flags & wb_Pool_NoZeroMemory)) {
+		for(i = 0; i < soa->fieldCount; ++i) {
+			WB_ALLOC_MEMSET((char*)soa->columns[i] + index * soa->fieldSizes[i],
+					0, soa->fieldSizes[i]);
+		}
+	}
+
+	return index;
+}
+
+WB_ALLOC_API
+void wb_soaRelease(wb_SoaPool* soa, wb_isize index)
+{
+	wb_poolRelease(soa->indices, 
+			(char*)soa->indices->slots + index * soa->indices->elementSize);
+}
+
+WB_ALLOC_API
+void* wb_soaColumn(wb_SoaPool* soa, wb_isize field)
+{
+	return soa->columns[field];
+}
+
+WB_ALLOC_API
+void* wb_soaField(wb_SoaPool* soa, wb_isize field, wb_isize index)
+{
+	return (char*)soa->columns[field] + index * soa->fieldSizes[field];
+}
+
+WB_ALLOC_API
+void wb_soaIterBegin(wb_SoaPool* soa, wb_PoolIterator* iter)
+{
+	wb_poolIterBegin(soa->indices, iter);
+}
+
+WB_ALLOC_API
+wb_isize wb_soaIterNext(wb_PoolIterator* iter)
+{
+	void* slot = wb_poolIterNext(iter);
+	if(!slot) return -1;
+	return ((wb_isize)slot - (wb_isize)iter->pool->slots) / 
+		(wb_isize)iter->pool->elementSize;
+}
+
+WB_ALLOC_API
+wb_isize wb_calcTaggedHeapSize(wb_isize arenaSize, wb_isize arenaCount,
+		wb_iflags bootstrapped)
+{
+	return arenaCount * (arenaSize + sizeof(wbi__TaggedHeapArena))
+		+ sizeof(wb_TaggedHeap) * bootstrapped;
+}
+
+WB_ALLOC_API
+void wb_taggedInit(wb_TaggedHeap* heap, wb_MemoryArena* arena, 
+		wb_isize internalArenaSize, wb_iflags flags)
+{
+	wb_isize i;
+#ifndef WB_ALLOC_NO_ZERO_ON_INIT
+	WB_ALLOC_MEMSET(heap, 0, sizeof(wb_TaggedHeap));
+#endif
+
+	heap->name = "taggedHeap";
+	wbi__stat(WB_ALLOC_MEMSET(&heap->stats, 0, sizeof(wb_AllocStats)));
+#ifndef WB_ALLOC_CAS
+	if(flags & wb_TaggedHeap_Concurrent) {
+		WB_ALLOC_ERROR_HANDLER("TaggedHeapConcurrent needs WB_ALLOC_CAS "
+				"on this compiler", heap, heap->name);
+		flags &= ~wb_TaggedHeap_Concurrent;
+	}
+#endif
+	heap->flags = flags;
+	heap->align = 8;
+	heap->arenaSize = internalArenaSize;
+	/* NOTE(will): blocks never go back to the pool, so it only hands out
+	 * fresh ones; unless it's in someone else's buffer (or an arena that 
+	 * doesn't recommit), those come straight from the OS already zeroed */
+	wb_poolInit(&heap->pool, arena, 
+			internalArenaSize + sizeof(wbi__TaggedHeapArena), 
+			wb_Pool_Normal | wb_Pool_NoDoubleFreeCheck | 
+			((flags & wb_TaggedHeap_NoZeroMemory) || 
+			 !(arena->flags & (wb_Arena_FixedSize | wb_Arena_NoRecommit)) ? 
+			wb_Pool_NoZeroMemory : 
+			0));
+
+	if((flags & wb_TaggedHeap_SizeClasses) && 
+			wbi__taggedClassStride(heap, WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 1) <
+			sizeof(wbi__TaggedHeapArena) * 4) {
+		WB_ALLOC_ERROR_HANDLER("the arenaSize is too small to split into "
+				"size classes", heap, heap->name);
+		heap->flags &= ~wb_TaggedHeap_SizeClasses;
+	}
+	for(i = 0; i < WB_ALLOC_TAGGEDHEAP_CLASS_COUNT; ++i) {
+		heap->classBlocks[i] = NULL;
+	}
+	heap->classFreed = 0;
+
+	heap->nextGeneration = 1;
+	heap->retiredCount = 0;
+	heap->frame = 0;
+	heap->retainBlocks = -1;
+	heap->epoch = 1;
+	heap->readerCount = 0;
+	for(i = 0; i < WB_ALLOC_TAGGEDHEAP_READER_COUNT; ++i) {
+		heap->readers[i].epoch = 0;
+		heap->readers[i].used = 0;
+	}
+	heap->limbo = NULL;
+	heap->limboPool = NULL;
+	heap->buckets = NULL;
+	heap->tagPool = NULL;
+	heap->binPool = NULL;
+	for(i = 0; i < WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT; ++i) {
+		wbi__taggedInitTag(heap, heap->tags + i, i);
+	}
+	for(i = 0; i < wbi__TaggedHeapFrameCount; ++i) {
+		wbi__taggedInitTag(heap, 
+				heap->tags + WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT + i,
+				WB_ALLOC_TAGGEDHEAP_FRAME_TAG_BASE + i);
+	}
+}
+
+WB_ALLOC_API
+wb_TaggedHeap* wb_taggedBootstrap(wb_MemoryInfo info, 
+		wb_isize arenaSize,
+		wb_iflags flags)
+{
+	wb_TaggedHeap* strapped;
+	wb_TaggedHeap heap;
+	wb_MemoryArena* arena;
+	info.commitSize = wb_calcTaggedHeapSize(arenaSize, 8, 1);
+	arena = wb_arenaBootstrap(info, 
+			((flags & wb_TaggedHeap_NoZeroMemory) ? 
+			wb_Arena_NoZeroMemory :
+			wb_Arena_Normal));
+	strapped = (wb_TaggedHeap*)wb_arenaPush(arena, sizeof(wb_TaggedHeap) + 16);
+	wb_taggedInit(&heap, arena, arenaSize, flags);
+	*strapped = heap;
+	return strapped;
+}
+
+WB_ALLOC_API
+wb_TaggedHeap* wb_taggedFixedSizeBootstrap(
+		wb_isize arenaSize, 
+		void* buffer, wb_isize bufferSize, 
+		wb_iflags flags)
+{
+	wb_MemoryArena* alloc;
+	wb_TaggedHeap* heap;
+	flags |= wb_TaggedHeap_FixedSize;
+	
+	alloc = arenaFixedSizeBootstrap(buffer, bufferSize, 
+			wb_Arena_FixedSize |
+			((flags & wb_TaggedHeap_NoZeroMemory) ? 
+			wb_Arena_NoZeroMemory : 0));
+	heap = (wb_TaggedHeap*)wb_arenaPush(alloc, sizeof(wb_TaggedHeap));
+
+	wb_taggedInit(heap, alloc, arenaSize, flags);
+	return heap;
+	
+}
+
+WB_ALLOC_API
+void wbi__taggedArenaInit(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapArena* arena,
+		wb_isize tag)
+{
+#ifndef WB_ALLOC_NO_ZERO_ON_INIT
+	WB_ALLOC_MEMSET(arena, 0, sizeof(wbi__TaggedHeapArena));
+#endif
+
+	arena->tag = tag;
+	arena->flags = 0;
+	arena->head = &arena->buffer;
+	arena->end = (void*)((char*)arena->head + heap->arenaSize);
+}
+
+WB_ALLOC_API
+void wbi__taggedArenaSortBySize(wbi__TaggedHeapArena** array, wb_isize count)
+{
+#define wbi__arenaSize(arena) ((wb_isize)arena->end - (wb_isize)arena->head)
+	wb_isize i, j, minSize;
+	for(i = 1; i < count; ++i) {
+		j = i - 1;
+
+		minSize = wbi__arenaSize(array[i]);
+		if(wbi__arenaSize(array[j]) > minSize) {
+			wbi__TaggedHeapArena* temp = array[i];
+			while((j >= 0) && (wbi__arenaSize(array[j]) > minSize)) {
+				array[j + 1] = array[j];
+				j--;
+			}
+			array[j + 1] = temp;
+		}
+	}
+#undef wbi__arenaSize
+}
+
+
+WB_ALLOC_API
+wb_isize wbi__atomicCas(volatile wb_usize* ptr, 
+		wb_usize oldValue, wb_usize newValue)
+{
+#ifdef WB_ALLOC_CAS
+	return WB_ALLOC_CAS(ptr, oldValue, newValue) ? 1 : 0;
+#else
+	if(*ptr != oldValue) return 0;
+	*ptr = newValue;
+	return 1;
+#endif
+}
+
+WB_ALLOC_API
+wb_usize wbi__atomicAdd(volatile wb_usize* ptr, wb_usize n)
+{
+	wb_usize value;
+	do {
+		value = *ptr;
+	} while(!wbi__atomicCas(ptr, value, value + n));
+	return value + n;
+}
+
+WB_ALLOC_API
+void wbi__spinLock(volatile wb_usize* lock)
+{
+	while(!wbi__atomicCas(lock, 0, 1)) {
+		while(*lock);
+	}
+}
+
+WB_ALLOC_API
+void wbi__spinUnlock(volatile wb_usize* lock)
+{
+	wbi__atomicCas(lock, 1, 0);
+}
+
+/* NOTE(will): a heap without wb_TaggedHeap_Concurrent only ever has one
+ * thread in it, so these fall back to plain stores there */
+#define wbi__taggedCas(heap, ptr, oldValue, newValue) \
+	(((heap)->flags & wb_TaggedHeap_Concurrent) ? \
+	 wbi__atomicCas((ptr), (oldValue), (newValue)) : \
+	 (*(ptr) = (newValue), 1))
+#define wbi__taggedAdd(heap, ptr, n) \
+	(((heap)->flags & wb_TaggedHeap_Concurrent) ? \
+	 wbi__atomicAdd((ptr), (n)) : (*(ptr) += (n)))
+
+/* NOTE(will): the shared free list of blocks is a Treiber stack. To dodge
+ * ABA, it's not a pointer: the low half of freeBlocks is the pool index of
+ * the top block (plus one, so zero is empty), and the high half is a 
+ * version that changes on every push and pop.
+ */
+#define wbi__TaggedIndexBits (sizeof(wb_usize) * 4)
+#define wbi__TaggedIndexMask (((wb_usize)1 << wbi__TaggedIndexBits) - 1)
+/* Enough pieces of the smallest class to have made up a whole block */
+#define wbi__TaggedCoalesceCount \
+	((wb_isize)1 << ((WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 1) * \
+	 WB_ALLOC_TAGGEDHEAP_CLASS_SHIFT))
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedPopBlock(wb_TaggedHeap* heap, 
+		volatile wb_usize* stack)
+{
+	wbi__TaggedHeapArena *block, *next;
+	wb_usize top, index, nextIndex;
+
+	do {
+		top = *stack;
+		index = top & wbi__TaggedIndexMask;
+		if(!index) return NULL;
+		block = (wbi__TaggedHeapArena*)wb_poolFromIndex(&heap->pool, 
+				(wb_isize)index - 1);
+		/* NOTE(will): if someone else pops this block first, this read is
+		 * junk, but then the version won't match and we go round again */
+		next = ((wbi__TaggedHeapArena* volatile*)&block->next)[0];
+		nextIndex = next ? (wb_usize)wb_poolIndex(&heap->pool, next) + 1 : 0;
+	} while(!wbi__taggedCas(heap, stack, top, 
+				(((top >> wbi__TaggedIndexBits) + 1) << 
+				 wbi__TaggedIndexBits) | nextIndex));
+	return block;
+}
+
+WB_ALLOC_API
+void wbi__taggedPushBlocks(wb_TaggedHeap* heap, volatile wb_usize* stack,
+		wbi__TaggedHeapArena* first, wbi__TaggedHeapArena* last)
+{
+	wb_usize top, index;
+
+	/* The blocks are already linked through next, so the whole chain goes 
+	 * onto the stack with one CAS */
+	do {
+		top = *stack;
+		index = top & wbi__TaggedIndexMask;
+		last->next = index ? 
+			(wbi__TaggedHeapArena*)wb_poolFromIndex(&heap->pool, 
+					(wb_isize)index - 1) : 
+			NULL;
+	} while(!wbi__taggedCas(heap, stack, top, 
+				(((top >> wbi__TaggedIndexBits) + 1) << 
+				 wbi__TaggedIndexBits) | 
+				((wb_usize)wb_poolIndex(&heap->pool, first) + 1)));
+}
+
+/* NOTE(will): a block's head only ever goes up, except for taggedPop and
+ * taggedEndTemp, which zero what they give back; so everything past it is
+ * still zero, and the head survives a trip through the free stacks (only
+ * next gets written). A block that's never been used has a NULL head, and
+ * just its header might be dirty */
+WB_ALLOC_API
+wb_usize wbi__taggedDirtySize(wbi__TaggedHeapArena* block, wb_usize size)
+{
+	wb_usize used;
+	used = (wb_usize)block->head - (wb_usize)block;
+	if(!block->head || used < sizeof(wbi__TaggedHeapArena)) {
+		used = sizeof(wbi__TaggedHeapArena);
+	}
+	return used < size ? used : size;
+}
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedAcquireBlock(wb_TaggedHeap* heap, 
+		wb_isize tag)
+{
+	wbi__TaggedHeapArena* block;
+	wb_isize first, last;
+	wb_usize dirtySize;
+	char* dirty;
+
+	if((block = wbi__taggedPopBlock(heap, &heap->cleanBlocks))) {
+		/* taggedZeroBlocks already did the work */
+		wbi__taggedAdd(heap, &heap->hotBlockCount, (wb_usize)-1);
+	} else if((block = wbi__taggedPopBlock(heap, &heap->freeBlocks))) {
+		wbi__taggedAdd(heap, &heap->hotBlockCount, (wb_usize)-1);
+		if(!(heap->flags & wb_TaggedHeap_NoZeroMemory)) {
+			dirtySize = wbi__taggedDirtySize(block, heap->pool.elementSize);
+			WB_ALLOC_MEMSET(block, 0, dirtySize);
+			wbi__stat(wbi__taggedAdd(heap, &heap->stats.zeroedBytes, 
+						dirtySize));
+		}
+	} else if((block = wbi__taggedPopBlock(heap, &heap->coldBlocks))) {
+		/* Trimmed blocks were recommitted, so only the partial pages at
+		 * either end (which taggedTrim couldn't drop) still need zeroing,
+		 * and only as far as the block was used */
+		if(!(heap->flags & wb_TaggedHeap_NoZeroMemory)) {
+			dirty = (char*)block + 
+				wbi__taggedDirtySize(block, heap->pool.elementSize);
+			first = wb_alignTo((wb_isize)&block->buffer, 
+					heap->pool.alloc->info.pageSize);
+			last = (wb_isize)((char*)block + heap->pool.elementSize) & 
+				~(wb_isize)(heap->pool.alloc->info.pageSize - 1);
+			if(last <= first || (wb_isize)dirty <= first) {
+				WB_ALLOC_MEMSET(block, 0, dirty - (char*)block);
+				wbi__stat(wbi__taggedAdd(heap, &heap->stats.zeroedBytes, 
+							dirty - (char*)block));
+			} else {
+				WB_ALLOC_MEMSET(block, 0, first - (wb_isize)block);
+				wbi__stat(wbi__taggedAdd(heap, &heap->stats.zeroedBytes, 
+							first - (wb_isize)block));
+				if((wb_isize)dirty > last) {
+					WB_ALLOC_MEMSET((void*)last, 0, (wb_isize)dirty - last);
+					wbi__stat(wbi__taggedAdd(heap, &heap->stats.zeroedBytes, 
+								(wb_isize)dirty - last));
+				}
+			}
+		}
+	} else {
+		/* The stacks are all empty, so carve a new block off the end of the
+		 * pool; this might need to commit memory, so it takes the lock */
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			wbi__spinLock(&heap->lock);
+			block = (wbi__TaggedHeapArena*)wb_poolRetrieve(&heap->pool);
+			wbi__spinUnlock(&heap->lock);
+		} else {
+			block = (wbi__TaggedHeapArena*)wb_poolRetrieve(&heap->pool);
+		}
+		if(!block) return NULL;
+	}
+
+	wbi__taggedArenaInit(heap, block, tag);
+	return block;
+}
+
+WB_ALLOC_API
+void wbi__taggedReleaseBlocks(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapArena* first, wbi__TaggedHeapArena* last,
+		wb_isize count)
+{
+	if(heap->flags & wb_TaggedHeap_SizeClasses) {
+		first = wbi__taggedReleaseClassBlocks(heap, first, &last, &count);
+		/* NOTE(will): coalescing sorts the class lists, so with a retain 
+		 * limit we only go looking for whole blocks once enough pieces
+		 * have come back that one could have filled up */
+		if(heap->retainBlocks >= 0 && 
+				heap->classFreed >= wbi__TaggedCoalesceCount) {
+			wbi__taggedCoalesceClassBlocks(heap);
+		}
+	}
+	if(first) {
+		wbi__taggedPushBlocks(heap, &heap->freeBlocks, first, last);
+		wbi__taggedAdd(heap, &heap->hotBlockCount, (wb_usize)count);
+	}
+	if(heap->retainBlocks >= 0 && 
+			(wb_isize)heap->hotBlockCount > heap->retainBlocks) {
+		wbi__taggedTrimBlocks(heap, heap->retainBlocks);
+	}
+}
+
+WB_ALLOC_API
+wb_isize wb_taggedTrim(wb_TaggedHeap* heap, wb_isize keep)
+{
+	if((heap->flags & wb_TaggedHeap_SizeClasses) && heap->classFreed) {
+		wbi__taggedCoalesceClassBlocks(heap);
+	}
+	return wbi__taggedTrimBlocks(heap, keep);
+}
+
+WB_ALLOC_API
+wb_isize wbi__taggedTrimBlocks(wb_TaggedHeap* heap, wb_isize keep)
+{
+	wbi__TaggedHeapArena* block;
+	wb_isize released;
+
+	if(heap->flags & wb_TaggedHeap_FixedSize) return 0;
+
+	/* NOTE(will): only the pages after the header are dropped, so the next
+	 * link stays readable for anyone racing us on the cold stack */
+	released = 0;
+	while((wb_isize)heap->hotBlockCount > keep) {
+		block = wbi__taggedPopBlock(heap, &heap->freeBlocks);
+		if(!block) block = wbi__taggedPopBlock(heap, &heap->cleanBlocks);
+		if(!block) break;
+		wbi__taggedAdd(heap, &heap->hotBlockCount, (wb_usize)-1);
+		if(wbi__releasePages(&block->buffer, 
+					(char*)block + heap->pool.elementSize, 
+					&heap->pool.alloc->info)) {
+			wbi__stat(wbi__taggedAdd(heap, &heap->stats.decommits, 1));
+			wbi__stat(wbi__taggedAdd(heap, &heap->stats.commits, 1));
+		}
+		wbi__taggedPushBlocks(heap, &heap->coldBlocks, block, block);
+		released++;
+	}
+	return released;
+}
+
+WB_ALLOC_API
+wb_isize wb_taggedZeroBlocks(wb_TaggedHeap* heap, wb_isize max)
+{
+	wbi__TaggedHeapArena* block;
+	wb_isize zeroed;
+	wb_usize dirtySize;
+
+	if(heap->flags & wb_TaggedHeap_NoZeroMemory) return 0;
+
+	/* NOTE(will): we could drop the pages instead, but then the zeroing 
+	 * just happens in the page faults on whoever takes the block next, 
+	 * which is the thread we're trying to save the time for */
+	zeroed = 0;
+	while(zeroed < max && 
+			(block = wbi__taggedPopBlock(heap, &heap->freeBlocks))) {
+		dirtySize = wbi__taggedDirtySize(block, heap->pool.elementSize);
+		WB_ALLOC_MEMSET(block, 0, dirtySize);
+		wbi__stat(wbi__taggedAdd(heap, &heap->stats.zeroedBytes, dirtySize));
+		wbi__taggedPushBlocks(heap, &heap->cleanBlocks, block, block);
+		zeroed++;
+	}
+	return zeroed;
+}
+
+WB_ALLOC_API
+wb_usize wbi__taggedClassStride(wb_TaggedHeap* heap, wb_isize sizeClass)
+{
+	return (heap->pool.elementSize >> 
+			(sizeClass * WB_ALLOC_TAGGEDHEAP_CLASS_SHIFT)) & ~(wb_usize)15;
+}
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedNextBlock(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wb_usize size)
+{
+	wbi__TaggedHeapArena *block, *carved;
+	wb_isize sizeClass, count, i;
+	wb_usize stride;
+
+	if(!(heap->flags & wb_TaggedHeap_SizeClasses)) {
+		return wbi__taggedAcquireBlock(heap, entry->tag);
+	}
+
+	/* A tag's first block is the smallest size, and each one after moves 
+	 * up a size, skipping any that are too small for this allocation */
+	sizeClass = WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 1 - 
+		(wb_isize)entry->blockCount;
+	if(sizeClass < 0) sizeClass = 0;
+	while(sizeClass > 0 && wbi__taggedClassStride(heap, sizeClass) < 
+			size + sizeof(wbi__TaggedHeapArena)) {
+		sizeClass--;
+	}
+	if(sizeClass == 0) {
+		return wbi__taggedAcquireBlock(heap, entry->tag);
+	}
+
+	stride = wbi__taggedClassStride(heap, sizeClass);
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinLock(&heap->lock);
+	}
+	block = heap->classBlocks[sizeClass];
+	if(block) {
+		heap->classBlocks[sizeClass] = block->next;
+	}
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinUnlock(&heap->lock);
+	}
+
+	if(block) {
+		if(!(heap->flags & wb_TaggedHeap_NoZeroMemory)) {
+			WB_ALLOC_MEMSET(block, 0, wbi__taggedDirtySize(block, stride));
+		}
+	} else {
+		/* None free in this size, so split up a whole block: we keep the 
+		 * first piece and the rest go on the class's free list */
+		block = wbi__taggedAcquireBlock(heap, entry->tag);
+		if(!block) return NULL;
+		count = (wb_isize)1 << (sizeClass * WB_ALLOC_TAGGEDHEAP_CLASS_SHIFT);
+		for(i = 1; i < count - 1; ++i) {
+			carved = (wbi__TaggedHeapArena*)((char*)block + i * stride);
+			carved->next = (wbi__TaggedHeapArena*)((char*)carved + stride);
+		}
+		carved = (wbi__TaggedHeapArena*)((char*)block + (count - 1) * stride);
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			wbi__spinLock(&heap->lock);
+		}
+		carved->next = heap->classBlocks[sizeClass];
+		heap->classBlocks[sizeClass] = 
+			(wbi__TaggedHeapArena*)((char*)block + stride);
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			wbi__spinUnlock(&heap->lock);
+		}
+	}
+
+	wbi__taggedArenaInit(heap, block, entry->tag);
+	block->flags = sizeClass << wbi__TaggedBlockClassShift;
+	block->end = (char*)block + stride;
+	return block;
+}
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedReleaseClassBlocks(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapArena* first, wbi__TaggedHeapArena** last,
+		wb_isize* count)
+{
+	wbi__TaggedHeapArena *block, *next, *whole, *wholeTail;
+	wb_isize sizeClass, wholeCount;
+
+	/* NOTE(will): carved blocks go back on their class's list (until 
+	 * taggedCoalesceClassBlocks finds all of a block's pieces there), and 
+	 * the whole ones are relinked into a chain that goes on the free stack
+	 * as usual */
+	whole = NULL;
+	wholeTail = NULL;
+	wholeCount = 0;
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinLock(&heap->lock);
+	}
+	for(block = first; block; block = next) {
+		next = block == *last ? NULL : block->next;
+		sizeClass = wbi__taggedBlockClass(block);
+		if(sizeClass) {
+			block->next = heap->classBlocks[sizeClass];
+			heap->classBlocks[sizeClass] = block;
+			heap->classFreed++;
+		} else {
+			block->next = whole;
+			whole = block;
+			if(!wholeTail) wholeTail = block;
+			wholeCount++;
+		}
+	}
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinUnlock(&heap->lock);
+	}
+
+	*last = wholeTail;
+	*count = wholeCount;
+	return whole;
+}
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedSortBlocks(wbi__TaggedHeapArena* list)
+{
+	wbi__TaggedHeapArena *p, *q, *e, *tail;
+	wb_isize width, merges, psize, qsize, i;
+
+	/* Bottom-up merge sort by address, same as poolSortFreeList */
+	for(width = 1; list; width *= 2) {
+		p = list;
+		list = NULL;
+		tail = NULL;
+		merges = 0;
+
+		while(p) {
+			merges++;
+			q = p;
+			psize = 0;
+			for(i = 0; i < width && q; ++i) {
+				psize++;
+				q = q->next;
+			}
+			qsize = width;
+
+			while(psize > 0 || (qsize > 0 && q)) {
+				if(psize == 0) {
+					e = q; q = q->next; qsize--;
+				} else if(qsize == 0 || !q) {
+					e = p; p = p->next; psize--;
+				} else if((wb_usize)p <= (wb_usize)q) {
+					e = p; p = p->next; psize--;
+				} else {
+					e = q; q = q->next; qsize--;
+				}
+				if(tail) {
+					tail->next = e;
+				} else {
+					list = e;
+				}
+				tail = e;
+			}
+			p = q;
+		}
+		if(tail) {
+			tail->next = NULL;
+		}
+
+		if(merges <= 1) break;
+	}
+	return list;
+}
+
+WB_ALLOC_API
+wb_isize wbi__taggedCoalesceClassBlocks(wb_TaggedHeap* heap)
+{
+	wbi__TaggedHeapArena **link, *block, *run, *parent, *whole, *wholeTail;
+	wb_isize sizeClass, pieces, n, wholeCount;
+	wb_usize stride;
+	char *parentEnd, *dirty, *end;
+
+	/* NOTE(will): with each class list in address order, a block's pieces 
+	 * sit next to each other, so a run of all of them means the whole 
+	 * block is free again. Its head is set to the end of the furthest 
+	 * piece anyone wrote to, which keeps the "zero past the head" promise
+	 * for whoever zeroes it next */
+	whole = NULL;
+	wholeTail = NULL;
+	wholeCount = 0;
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinLock(&heap->lock);
+	}
+	for(sizeClass = 1; sizeClass < WB_ALLOC_TAGGEDHEAP_CLASS_COUNT; 
+			++sizeClass) {
+		stride = wbi__taggedClassStride(heap, sizeClass);
+		pieces = (wb_isize)1 << (sizeClass * WB_ALLOC_TAGGEDHEAP_CLASS_SHIFT);
+		heap->classBlocks[sizeClass] = 
+			wbi__taggedSortBlocks(heap->classBlocks[sizeClass]);
+		link = &heap->classBlocks[sizeClass];
+		while((block = *link)) {
+			parent = (wbi__TaggedHeapArena*)wb_poolFromIndex(&heap->pool, 
+					wb_poolIndex(&heap->pool, block));
+			parentEnd = (char*)parent + heap->pool.elementSize;
+			dirty = (char*)parent;
+			run = block;
+			for(n = 1; ; ++n) {
+				end = (char*)run + wbi__taggedDirtySize(run, stride);
+				if(end > dirty) dirty = end;
+				if(n == pieces || !run->next || 
+						(char*)run->next >= parentEnd) break;
+				run = run->next;
+			}
+			if(n < pieces) {
+				link = &run->next;
+				continue;
+			}
+			*link = run->next;
+			parent->head = dirty;
+			parent->next = whole;
+			whole = parent;
+			if(!wholeTail) wholeTail = parent;
+			wholeCount++;
+		}
+	}
+	heap->classFreed = 0;
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinUnlock(&heap->lock);
+	}
+
+	if(whole) {
+		wbi__taggedPushBlocks(heap, &heap->freeBlocks, whole, wholeTail);
+		wbi__taggedAdd(heap, &heap->hotBlockCount, (wb_usize)wholeCount);
+	}
+	return wholeCount;
+}
+
+WB_ALLOC_API
+void wbi__taggedLinkBlock(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wbi__TaggedHeapArena* block)
+{
+	/* NOTE(will): blocks only ever get pushed on top, so the first one in
+	 * is the tail for good (until the tag is freed). The head, tail and 
+	 * count have to change together, or a free racing the first push could
+	 * take the chain without its tail, so concurrent heaps take tagLock
+	 * here and in taggedDetachTag. It's only once per block, not per 
+	 * allocation */
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinLock(&heap->tagLock);
+	}
+	block->next = entry->blocks;
+	if(!block->next) {
+		entry->tail = block;
+	}
+	entry->blocks = block;
+	entry->blockCount++;
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinUnlock(&heap->tagLock);
+	}
+}
+
+WB_ALLOC_API
+wb_usize wbi__taggedHash(wb_isize tag)
+{
+	/* Fibonacci hashing; the shifts make the constant 32-bit safe */
+	wb_usize h = (wb_usize)tag * 
+		((((wb_usize)0x9E3779B9 << 16) << 16) | (wb_usize)0x7F4A7C15);
+	return h ^ (h >> (sizeof(wb_usize) * 4));
+}
+
+WB_ALLOC_API
+void wbi__taggedInitTag(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wb_isize tag)
+{
+	entry->tag = tag;
+	entry->next = NULL;
+	entry->blocks = NULL;
+	entry->tail = NULL;
+	entry->large = NULL;
+	entry->largeTail = NULL;
+	entry->bins = NULL;
+	entry->flags = 0;
+	entry->tempBlock = NULL;
+	entry->tempLarge = NULL;
+	entry->tempHead = NULL;
+	entry->rewindBlock = NULL;
+	entry->rewindHead = NULL;
+	entry->rewinds = 0;
+	entry->blockCount = 0;
+	/* NOTE(will): generations are unique across the whole heap, not just 
+	 * per tag, since a hashed tag's entry can be reused by the same tag 
+	 * later on, and a thread might still have the old one cached */
+	entry->generation = wbi__taggedAdd(heap, &heap->nextGeneration, 1);
+}
+
+WB_ALLOC_API
+wbi__TaggedHeapTag* wbi__taggedDirectTag(wb_TaggedHeap* heap, wb_isize tag)
+{
+	wb_usize frame;
+
+	if(tag >= 0 && tag < WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT) {
+		return heap->tags + tag;
+	}
+
+	/* NOTE(will): unsigned, so tags far from the base can't overflow; a 
+	 * frame tag's slot might have moved on to a newer frame, which the 
+	 * caller sees from the entry's tag */
+	frame = (wb_usize)tag - (wb_usize)WB_ALLOC_TAGGEDHEAP_FRAME_TAG_BASE;
+	if(frame > (wb_usize)heap->frame) return NULL;
+	return heap->tags + WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT + 
+		frame % wbi__TaggedHeapFrameCount;
+}
+
+WB_ALLOC_API
+wbi__TaggedHeapTag* wbi__taggedFindTag(wb_TaggedHeap* heap, 
+		wb_isize tag, wb_isize create)
+{
+	wbi__TaggedHeapTag* entry;
+	wb_MemoryInfo info;
+	wb_usize bucket;
+
+	entry = wbi__taggedDirectTag(heap, tag);
+	if(entry) {
+		if(entry->tag == tag) return entry;
+		if(create) {
+			WB_ALLOC_ERROR_HANDLER("can't use a frame tag once its frame "
+					"has been freed", heap, heap->name);
+		}
+		return NULL;
+	}
+
+	if(heap->flags & wb_TaggedHeap_FixedSize) {
+		WB_ALLOC_ERROR_HANDLER("fixed-size tagged heaps only support tags "
+				"below WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT",
+				heap, heap->name);
+		return NULL;
+	}
+
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinLock(&heap->tagLock);
+	}
+
+	if(!heap->buckets && create) {
+		info = heap->pool.alloc->info;
+		info.commitSize = info.pageSize;
+		heap->tagPool = wb_poolBootstrap(info, sizeof(wbi__TaggedHeapTag), 
+				wb_Pool_NoZeroMemory | wb_Pool_NoDoubleFreeCheck | 
+				wb_Pool_GeometricGrowth);
+		info.totalMemory = wb_alignTo(info.totalMemory / 16, info.pageSize);
+		heap->bucketAlloc = wb_arenaBootstrap(info, wb_Arena_Normal);
+		heap->bucketCount = 64;
+		heap->hashedCount = 0;
+		heap->buckets = (wbi__TaggedHeapTag**)wb_arenaPush(heap->bucketAlloc,
+				heap->bucketCount * sizeof(wbi__TaggedHeapTag*));
+	}
+
+	entry = NULL;
+	if(heap->buckets) {
+		bucket = wbi__taggedHash(tag) & (heap->bucketCount - 1);
+		entry = heap->buckets[bucket];
+		while(entry && entry->tag != tag) {
+			entry = entry->next;
+		}
+
+		if(!entry && create) {
+			entry = (wbi__TaggedHeapTag*)wb_poolRetrieve(heap->tagPool);
+			if(entry) {
+				wbi__taggedInitTag(heap, entry, tag);
+				entry->next = heap->buckets[bucket];
+				heap->buckets[bucket] = entry;
+				if(++heap->hashedCount > heap->bucketCount) {
+					wbi__taggedGrowBuckets(heap);
+				}
+			}
+		}
+	}
+
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinUnlock(&heap->tagLock);
+	}
+	return entry;
+}
+
+WB_ALLOC_API
+void wbi__taggedGrowBuckets(wb_TaggedHeap* heap)
+{
+	wbi__TaggedHeapTag **buckets, *entry, *next, *stay;
+	wb_isize i, count;
+
+	/* NOTE(will): the bucket array is the only thing in its arena, so it 
+	 * can double in place. With a power-of-two mask, everything in bucket 
+	 * i either stays there or moves to i + count, so one pass splits them */
+	count = heap->bucketCount;
+	buckets = (wbi__TaggedHeapTag**)wb_arenaPush(heap->bucketAlloc, 
+			count * sizeof(wbi__TaggedHeapTag*));
+	if(!buckets) return;
+	WB_ALLOC_MEMSET(buckets, 0, count * sizeof(wbi__TaggedHeapTag*));
+
+	buckets = heap->buckets;
+	for(i = 0; i < count; ++i) {
+		entry = buckets[i];
+		stay = NULL;
+		while(entry) {
+			next = entry->next;
+			if(wbi__taggedHash(entry->tag) & count) {
+				entry->next = buckets[i + count];
+				buckets[i + count] = entry;
+			} else {
+				entry->next = stay;
+				stay = entry;
+			}
+			entry = next;
+		}
+		buckets[i] = stay;
+	}
+	heap->bucketCount = count * 2;
+}
+
+WB_ALLOC_API
+void* wb_taggedAlloc(wb_TaggedHeap* heap, wb_isize tag, wb_usize size)
+{
+	wbi__TaggedHeapArena *arena, *newArena;
+	wbi__TaggedHeapTag* entry;
+	void* oldHead;
+	wbi__TaggedHeapArena* canFit[wbi__TaggedHeapSearchSize];
+	wb_isize canFitCount = 0;
+
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinLock(&heap->sharedLock);
+		heap->shared.heap = heap;
+		oldHead = wb_taggedThreadAlloc(&heap->shared, tag, size);
+		wbi__spinUnlock(&heap->sharedLock);
+		return oldHead;
+	}
+
+	entry = wbi__taggedFindTag(heap, tag, 1);
+	if(!entry) return NULL;
+	wbi__stat(heap->stats.allocs++);
+	wbi__stat(heap->stats.bytes += size);
+	wbi__traced(wbi__traceTagged(heap, wb_Trace_TaggedAlloc, tag, size));
+
+	if(entry->flags) {
+		return wbi__taggedAllocEx(heap, entry, size, 0, 0);
+	}
+
+	if(size > heap->arenaSize) {
+		return wbi__taggedAllocLarge(heap, entry, size);
+	}
+
+	if(!entry->blocks) {
+		newArena = wbi__taggedNextBlock(heap, entry, size);
+		if(!newArena) {
+			WB_ALLOC_ERROR_HANDLER("tagged heap arena retrieve returned null "
+					"when creating a new tag",
+				heap, heap->name);
+			return NULL;
+		}
+		wbi__taggedLinkBlock(heap, entry, newArena);
+	}
+
+	arena = entry->blocks;
+
+	if((char*)arena->head + size > (char*)arena->end) {
+		if((heap->flags & wb_TaggedHeap_SearchForBestFit) &&
+				!(heap->flags & wb_TaggedHeap_FixedSize)) {
+			arena = wbi__taggedFindFit(entry, size);
+			if(!arena) {
+				newArena = wbi__taggedNextBlock(heap, entry, size);
+				if(!newArena) {
+					WB_ALLOC_ERROR_HANDLER(
+							"tagged heap arena retrieve returned null",
+							heap, heap->name);
+					return NULL;
+				}
+				wbi__taggedBinBlock(heap, entry, entry->blocks);
+				wbi__taggedLinkBlock(heap, entry, newArena);
+				arena = newArena;
+			}
+
+			oldHead = arena->head;
+			arena->head = (void*)wb_alignTo((wb_isize)arena->head + size, 
+					heap->align);
+			if(arena != entry->blocks) {
+				wbi__taggedBinBlock(heap, entry, arena);
+			}
+			return oldHead;
+		}
+
+		if(heap->flags & wb_TaggedHeap_SearchForBestFit) {
+			while((arena = arena->next)) {
+				if((char*)arena->head + size <= (char*)arena->end) {
+					canFit[canFitCount++] = arena;
+					if(canFitCount > (wbi__TaggedHeapSearchSize - 1)) {
+						break;
+					}
+				}
+			}
+
+			if(canFitCount > 0) {
+				wbi__taggedArenaSortBySize(canFit, canFitCount);
+				arena = canFit[0];
+			}
+		}
+
+		if(canFitCount == 0) {
+			newArena = wbi__taggedNextBlock(heap, entry, size);
+			if(!newArena) {
+				WB_ALLOC_ERROR_HANDLER(
+						"tagged heap arena retrieve returned null",
+						heap, heap->name);
+				return NULL;
+			}
+			wbi__taggedLinkBlock(heap, entry, newArena);
+			arena = newArena;
+		}
+	}
+
+	oldHead = arena->head;
+	arena->head = (void*)wb_alignTo((wb_isize)arena->head + size, heap->align);
+	return oldHead;
+}
+
+WB_ALLOC_API
+wb_isize wbi__taggedBinIndex(wb_usize space)
+{
+	wb_isize bin = -1;
+	space >>= wbi__TaggedHeapBinShift;
+	while(space) {
+		bin++;
+		space >>= 1;
+	}
+	return bin < wbi__TaggedHeapBinCount ? bin : wbi__TaggedHeapBinCount - 1;
+}
+
+WB_ALLOC_API
+void wbi__taggedBinBlock(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wbi__TaggedHeapArena* block)
+{
+	wbi__TaggedHeapBins* bins;
+	wb_MemoryInfo info;
+	wb_isize bin;
+
+	bin = wbi__taggedBinIndex((wb_usize)block->end - (wb_usize)block->head);
+	if(bin < 0) return;
+
+	if(!entry->bins) {
+		if(!heap->binPool) {
+			info = heap->pool.alloc->info;
+			info.commitSize = info.pageSize;
+			heap->binPool = wb_poolBootstrap(info, 
+					sizeof(wbi__TaggedHeapBins), 
+					wb_Pool_NoDoubleFreeCheck | wb_Pool_GeometricGrowth);
+		}
+		entry->bins = (wbi__TaggedHeapBins*)wb_poolRetrieve(heap->binPool);
+		if(!entry->bins) return;
+	}
+
+	bins = entry->bins;
+	block->binPrev = NULL;
+	block->binNext = bins->heads[bin];
+	if(block->binNext) {
+		block->binNext->binPrev = block;
+	} else {
+		bins->tails[bin] = block;
+	}
+	bins->heads[bin] = block;
+	bins->mask |= (wb_usize)1 << bin;
+}
+
+WB_ALLOC_API
+wbi__TaggedHeapArena* wbi__taggedFindFit(wbi__TaggedHeapTag* entry, 
+		wb_usize size)
+{
+	wbi__TaggedHeapBins* bins;
+	wbi__TaggedHeapArena *block, *best;
+	wb_isize bin;
+	wb_usize mask;
+
+	bins = entry->bins;
+	if(!bins || !bins->mask) return NULL;
+
+	/* Blocks in size's own bin may or may not fit, so check those for the 
+	 * tightest one that does; every block in a higher bin fits for sure, 
+	 * so the lowest nonempty one of those has the best fit there is, and 
+	 * we take the tightest in it. A bin's blocks can be up to twice as big
+	 * as each other, so the first one in it could waste a lot */
+	bin = wbi__taggedBinIndex(size);
+	if(bin < 0) bin = 0;
+	best = NULL;
+	block = bins->heads[bin];
+	while(block) {
+		if((char*)block->head + size <= (char*)block->end && (!best || 
+					(wb_usize)block->end - (wb_usize)block->head < 
+					(wb_usize)best->end - (wb_usize)best->head)) {
+			best = block;
+		}
+		block = block->binNext;
+	}
+
+	if(!best) {
+		mask = bins->mask & ~(((wb_usize)2 << bin) - 1);
+		if(!mask) return NULL;
+		bin = wbi__ctz(mask);
+		best = bins->heads[bin];
+		block = best->binNext;
+		while(block) {
+			if((wb_usize)block->end - (wb_usize)block->head < 
+					(wb_usize)best->end - (wb_usize)best->head) {
+				best = block;
+			}
+			block = block->binNext;
+		}
+	}
+
+	/* Take it out; it goes back in wherever it belongs after the alloc */
+	if(best->binPrev) {
+		best->binPrev->binNext = best->binNext;
+	} else {
+		bins->heads[bin] = best->binNext;
+		if(!best->binNext) {
+			bins->mask &= ~((wb_usize)1 << bin);
+		}
+	}
+	if(best->binNext) {
+		best->binNext->binPrev = best->binPrev;
+	} else {
+		bins->tails[bin] = best->binPrev;
+	}
+	return best;
+}
+
+WB_ALLOC_API
+wb_isize wbi__taggedDetachTag(wb_TaggedHeap* heap, wb_isize tag, 
+		wbi__TaggedHeapTag* out)
+{
+	wbi__TaggedHeapTag *entry, **link;
+	wb_usize bucket;
+
+	entry = wbi__taggedDirectTag(heap, tag);
+	if(entry) {
+		if(entry->tag != tag) return 0;
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			wbi__spinLock(&heap->tagLock);
+		}
+		out->blocks = entry->blocks;
+		out->tail = entry->tail;
+		out->large = entry->large;
+		out->largeTail = entry->largeTail;
+		out->blockCount = entry->blockCount;
+		out->bins = entry->bins;
+		entry->blocks = NULL;
+		entry->tail = NULL;
+		entry->large = NULL;
+		entry->largeTail = NULL;
+		entry->blockCount = 0;
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			wbi__spinUnlock(&heap->tagLock);
+		}
+		entry->flags = 0;
+		entry->tempBlock = NULL;
+		entry->tempLarge = NULL;
+		entry->tempHead = NULL;
+		entry->rewindBlock = NULL;
+		entry->rewindHead = NULL;
+		entry->bins = NULL;
+		entry->generation = wbi__taggedAdd(heap, &heap->nextGeneration, 1);
+		return 1;
+	} 
+
+	/* Hashed tags are unlinked and their entry goes back to the pool, 
+	 * so the table only ever holds live tags */
+	if(!heap->buckets) return 0;
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinLock(&heap->tagLock);
+	}
+
+	bucket = wbi__taggedHash(tag) & (heap->bucketCount - 1);
+	link = heap->buckets + bucket;
+	while(*link && (*link)->tag != tag) {
+		link = &(*link)->next;
+	}
+
+	entry = *link;
+	if(entry) {
+		*link = entry->next;
+		heap->hashedCount--;
+		out->blocks = entry->blocks;
+		out->tail = entry->tail;
+		out->large = entry->large;
+		out->largeTail = entry->largeTail;
+		out->blockCount = entry->blockCount;
+		out->bins = entry->bins;
+		entry->generation = wbi__taggedAdd(heap, &heap->nextGeneration, 1);
+		wb_poolRelease(heap->tagPool, entry);
+	}
+
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinUnlock(&heap->tagLock);
+	}
+	return entry != NULL;
+}
+
+WB_ALLOC_API
+void wb_taggedFree(wb_TaggedHeap* heap, wb_isize tag)
+{
+	wbi__TaggedHeapTag detached;
+
+	if(!wbi__taggedDetachTag(heap, tag, &detached)) return;
+	wbi__traced(wbi__traceTagged(heap, wb_Trace_TaggedFree, tag, 0));
+	wbi__taggedReleaseDetached(heap, &detached);
+}
+
+WB_ALLOC_API
+void wbi__taggedReleaseDetached(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* detached)
+{
+	wbi__TaggedHeapArena *large, *next;
+
+	/* The tag keeps its tail, so the whole chain goes back in one push; 
+	 * large blocks are their own mappings, so they go straight to the OS */
+	if(detached->blocks) {
+		wbi__taggedReleaseBlocks(heap, detached->blocks, detached->tail, 
+				(wb_isize)detached->blockCount);
+	}
+
+	if(detached->bins) {
+		wb_poolRelease(heap->binPool, detached->bins);
+	}
+
+	large = detached->large;
+	while(large) {
+		next = large->next;
+		wbi__freeAddressSpace(large, (wb_usize)large->end - (wb_usize)large);
+		wbi__stat(wbi__taggedAdd(heap, &heap->stats.decommits, 1));
+		large = next;
+	}
+	wbi__stat(wbi__taggedAdd(heap, &heap->stats.frees, 1));
+}
+
+WB_ALLOC_API
+void wbi__taggedSiftObject(wb_TaggedObject* objects, 
+		wb_isize root, wb_isize end)
+{
+	wb_TaggedObject temp;
+	wb_isize child;
+	while((child = root * 2 + 1) < end) {
+		if(child + 1 < end && (wb_usize)objects[child].ptr < 
+				(wb_usize)objects[child + 1].ptr) {
+			child++;
+		}
+		if((wb_usize)objects[root].ptr >= (wb_usize)objects[child].ptr) break;
+		temp = objects[root];
+		objects[root] = objects[child];
+		objects[child] = temp;
+		root = child;
+	}
+}
+
+WB_ALLOC_API
+void wbi__taggedSortObjects(wb_TaggedObject* objects, wb_isize count)
+{
+	wb_TaggedObject temp;
+	wb_isize i;
+
+	/* NOTE(will): heapsort, since there could be a lot of these and we 
+	 * don't pull in qsort */
+	for(i = count / 2 - 1; i >= 0; --i) {
+		wbi__taggedSiftObject(objects, i, count);
+	}
+	for(i = count - 1; i > 0; --i) {
+		temp = objects[0];
+		objects[0] = objects[i];
+		objects[i] = temp;
+		wbi__taggedSiftObject(objects, 0, i);
+	}
+}
+
+WB_ALLOC_API
+wb_isize wbi__taggedCountOwned(wbi__TaggedHeapArena* block, 
+		wb_TaggedObject* objects, wb_isize count)
+{
+	wb_isize low, high, mid, owned;
+
+	/* NOTE(will): objects are sorted and blocks don't overlap, so a block's
+	 * objects are the run from the first one at or past its buffer. Large 
+	 * blocks have head at the end, so the same check works for those */
+	owned = 0;
+	for(; block; block = block->next) {
+		low = 0;
+		high = count;
+		while(low < high) {
+			mid = low + (high - low) / 2;
+			if((char*)objects[mid].ptr < (char*)&block->buffer) {
+				low = mid + 1;
+			} else {
+				high = mid;
+			}
+		}
+		while(low < count && (char*)objects[low].ptr + objects[low].size <=
+				(char*)block->head) {
+			owned++;
+			low++;
+		}
+	}
+	return owned;
+}
+
+WB_ALLOC_API
+void* wb_taggedForward(wb_TaggedObject* objects, wb_isize count, void* ptr)
+{
+	wb_isize low, high, mid;
+	wb_usize p;
+
+	/* Find the last object starting at or before ptr */
+	p = (wb_usize)ptr;
+	low = 0;
+	high = count - 1;
+	while(low <= high) {
+		mid = low + (high - low) / 2;
+		if((wb_usize)objects[mid].ptr <= p) {
+			low = mid + 1;
+		} else {
+			high = mid - 1;
+		}
+	}
+
+	if(high < 0 || !objects[high].moved || 
+			p >= (wb_usize)objects[high].ptr + objects[high].size) {
+		return ptr;
+	}
+	return (char*)objects[high].moved + (p - (wb_usize)objects[high].ptr);
+}
+
+WB_ALLOC_API
+wb_isize wb_taggedEvacuate(wb_TaggedHeap* heap, wb_isize from, wb_isize into,
+		wb_TaggedObject* objects, wb_isize count)
+{
+	wbi__TaggedHeapTag *entry, *intoEntry;
+	wb_TaggedObject* object;
+	WB_ALLOC_EXTENDED_INFO extended;
+	wb_isize i, j, isExtended;
+	wb_iflags tempFlag;
+	wbi__TaggedHeapArena *tempBlock, *tempLarge;
+	void* tempHead;
+	void** field;
+
+	if(from == into) {
+		WB_ALLOC_ERROR_HANDLER("can't evacuate a tag into itself",
+				heap, heap->name);
+		return -1;
+	}
+
+	entry = wbi__taggedFindTag(heap, from, 0);
+	if(!entry) {
+		WB_ALLOC_ERROR_HANDLER("can't evacuate a tag that doesn't exist",
+				heap, heap->name);
+		return -1;
+	}
+	isExtended = entry->flags & wb_Arena_Extended;
+
+	wbi__taggedSortObjects(objects, count);
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(wbi__taggedCountOwned(entry->blocks, objects, count) + 
+			wbi__taggedCountOwned(entry->large, objects, count) != count) {
+		WB_ALLOC_ERROR_HANDLER("can't evacuate an object that isn't in the "
+				"from tag", heap, heap->name);
+		return -1;
+	}
+#endif
+
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		/* NOTE(will): concurrent heaps only have taggedAlloc, so tags 
+		 * there can't be extended, but they can't align either */
+		for(i = 0; i < count; ++i) {
+			if(objects[i].align > heap->align) {
+				WB_ALLOC_ERROR_HANDLER("can't evacuate objects aligned past "
+						"the heap's alignment on a concurrent heap",
+						heap, heap->name);
+				return -1;
+			}
+		}
+		intoEntry = NULL;
+	} else {
+		intoEntry = wbi__taggedFindTag(heap, into, 1);
+		if(!intoEntry) return -1;
+		if(isExtended && !(intoEntry->flags & wb_Arena_Extended)) {
+			WB_ALLOC_ERROR_HANDLER("can't evacuate an extended tag into one "
+					"that isn't", heap, heap->name);
+			return -1;
+		}
+	}
+
+	for(i = 0; i < count; ++i) {
+		objects[i].moved = NULL;
+	}
+
+	/* NOTE(will): the copies go in under a temp scope of our own, so if we
+	 * run out partway, taggedEndTemp takes them all back out of into. If 
+	 * into was already in one, its scope is put back afterwards. */
+	tempFlag = 0;
+	tempBlock = tempLarge = NULL;
+	tempHead = NULL;
+	if(intoEntry) {
+		tempFlag = intoEntry->flags & wbi__TaggedTagTemp;
+		tempBlock = intoEntry->tempBlock;
+		tempLarge = intoEntry->tempLarge;
+		tempHead = intoEntry->tempHead;
+		intoEntry->flags &= ~wbi__TaggedTagTemp;
+		wb_taggedStartTemp(heap, into);
+	}
+
+	for(i = 0; i < count; ++i) {
+		object = objects + i;
+		extended = isExtended ? 
+			((WB_ALLOC_EXTENDED_INFO*)object->ptr)[-1] : 0;
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			object->moved = wb_taggedAlloc(heap, into, object->size);
+		} else {
+			object->moved = wb_taggedAllocEx(heap, into, object->size, 
+					object->align, extended);
+		}
+		if(!object->moved) break;
+		WB_ALLOC_MEMCPY(object->moved, object->ptr, object->size);
+	}
+
+	if(intoEntry) {
+		if(i < count) {
+			wb_taggedEndTemp(heap, into);
+		}
+		intoEntry->flags = (intoEntry->flags & ~wbi__TaggedTagTemp) | tempFlag;
+		intoEntry->tempBlock = tempBlock;
+		intoEntry->tempLarge = tempLarge;
+		intoEntry->tempHead = tempHead;
+	}
+	if(i < count) {
+		for(i = 0; i < count; ++i) {
+			objects[i].moved = NULL;
+		}
+		WB_ALLOC_ERROR_HANDLER("ran out of memory evacuating a tag",
+				heap, heap->name);
+		return -1;
+	}
+
+	/* Everything has a new home now, so the pointers can be forwarded */
+	for(i = 0; i < count; ++i) {
+		object = objects + i;
+		for(j = 0; j < object->pointerCount; ++j) {
+			field = (void**)((char*)object->moved + object->pointers[j]);
+			*field = wb_taggedForward(objects, count, *field);
+		}
+	}
+
+	wb_taggedFree(heap, from);
+	return count;
+}
+
+WB_ALLOC_API
+wb_isize wb_taggedReaderRegister(wb_TaggedHeap* heap)
+{
+	wb_isize reader;
+	wb_usize count;
+
+	/* NOTE(will): readerCount is how far up the slots have ever been used,
+	 * so taggedReclaim doesn't have to look past it; a freed slot under it
+	 * just reads as not pinned */
+	for(reader = 0; reader < WB_ALLOC_TAGGEDHEAP_READER_COUNT; ++reader) {
+		if(!heap->readers[reader].used && 
+				wbi__atomicCas(&heap->readers[reader].used, 0, 1)) {
+			heap->readers[reader].epoch = 0;
+			do {
+				count = heap->readerCount;
+			} while(count < (wb_usize)reader + 1 && 
+					!wbi__atomicCas(&heap->readerCount, count, 
+						(wb_usize)reader + 1));
+			return reader;
+		}
+	}
+	WB_ALLOC_ERROR_HANDLER("out of reader slots; raise "
+			"WB_ALLOC_TAGGEDHEAP_READER_COUNT", heap, heap->name);
+	return -1;
+}
+
+WB_ALLOC_API
+void wb_taggedReaderUnregister(wb_TaggedHeap* heap, wb_isize reader)
+{
+	if(reader < 0 || reader >= WB_ALLOC_TAGGEDHEAP_READER_COUNT) return;
+	wbi__atomicCas(&heap->readers[reader].epoch, 
+			heap->readers[reader].epoch, 0);
+	wbi__atomicCas(&heap->readers[reader].used, 1, 0);
+	/* Anything it was holding up might be free to go now */
+	wb_taggedReclaim(heap);
+}
+
+WB_ALLOC_API
+void wb_taggedReadBegin(wb_TaggedHeap* heap, wb_isize reader)
+{
+	/* NOTE(will): the CAS is a full barrier, so the pin is visible before
+	 * any of our reads happen. If the epoch moves on between reading it 
+	 * and pinning it, we've just pinned an older epoch than we needed to, 
+	 * which only holds things up a bit longer */
+	wbi__atomicCas(&heap->readers[reader].epoch, 0, heap->epoch);
+}
+
+WB_ALLOC_API
+void wb_taggedReadEnd(wb_TaggedHeap* heap, wb_isize reader)
+{
+	wbi__atomicCas(&heap->readers[reader].epoch, 
+			heap->readers[reader].epoch, 0);
+}
+
+WB_ALLOC_API
+void wb_taggedFreeDeferred(wb_TaggedHeap* heap, wb_isize tag)
+{
+	wbi__TaggedHeapLimbo* limbo;
+	wbi__TaggedHeapTag detached;
+	wb_MemoryInfo info;
+
+	if(!wbi__taggedDetachTag(heap, tag, &detached)) return;
+	wbi__traced(wbi__traceTagged(heap, wb_Trace_TaggedFree, tag, 0));
+
+	/* NOTE(will): the bins are the owner's, so they go back now instead of
+	 * from whichever thread ends up reclaiming the tag */
+	if(detached.bins) {
+		wb_poolRelease(heap->binPool, detached.bins);
+		detached.bins = NULL;
+	}
+
+	wbi__spinLock(&heap->limboLock);
+	if(!heap->limboPool) {
+		info = heap->pool.alloc->info;
+		info.commitSize = info.pageSize;
+		heap->limboPool = wb_poolBootstrap(info, 
+				sizeof(wbi__TaggedHeapLimbo), 
+				wb_Pool_NoZeroMemory | wb_Pool_NoDoubleFreeCheck | 
+				wb_Pool_GeometricGrowth);
+	}
+	limbo = heap->limboPool ? 
+		(wbi__TaggedHeapLimbo*)wb_poolRetrieve(heap->limboPool) : 
+		NULL;
+	if(!limbo) {
+		wbi__spinUnlock(&heap->limboLock);
+		WB_ALLOC_ERROR_HANDLER("couldn't queue a deferred free; the tag's "
+				"memory is lost", heap, heap->name);
+		return;
+	}
+
+	/* Anyone pinned at this epoch or earlier might have seen the tag's 
+	 * data; anyone who pins after we move the epoch on can't have */
+	limbo->detached = detached;
+	limbo->epoch = heap->epoch;
+	limbo->next = heap->limbo;
+	heap->limbo = limbo;
+	wbi__spinUnlock(&heap->limboLock);
+
+	wbi__atomicAdd(&heap->epoch, 1);
+	wb_taggedReclaim(heap);
+}
+
+WB_ALLOC_API
+wb_isize wb_taggedReclaim(wb_TaggedHeap* heap)
+{
+	wbi__TaggedHeapLimbo *limbo, **link;
+	wb_usize oldest, pinned;
+	wb_isize i, count, freed;
+
+	if(!heap->limbo) return 0;
+
+	oldest = heap->epoch;
+	count = (wb_isize)heap->readerCount;
+	if(count > WB_ALLOC_TAGGEDHEAP_READER_COUNT) {
+		count = WB_ALLOC_TAGGEDHEAP_READER_COUNT;
+	}
+	for(i = 0; i < count; ++i) {
+		pinned = heap->readers[i].epoch;
+		if(pinned && pinned < oldest) {
+			oldest = pinned;
+		}
+	}
+
+	freed = 0;
+	wbi__spinLock(&heap->limboLock);
+	link = &heap->limbo;
+	while((limbo = *link)) {
+		if(limbo->epoch < oldest) {
+			*link = limbo->next;
+			wbi__taggedReleaseDetached(heap, &limbo->detached);
+			wb_poolRelease(heap->limboPool, limbo);
+			freed++;
+		} else {
+			link = &limbo->next;
+		}
+	}
+	wbi__spinUnlock(&heap->limboLock);
+	return freed;
+}
+
+WB_ALLOC_API
+void wb_taggedMerge(wb_TaggedHeap* heap, wb_isize from, wb_isize into)
+{
+	wbi__TaggedHeapTag *entry, *fromEntry, detached;
+	wbi__TaggedHeapBins* bins;
+	wb_isize bin, binned;
+
+	if(from == into) return;
+	fromEntry = wbi__taggedFindTag(heap, from, 0);
+	if(!fromEntry) return;
+	entry = wbi__taggedFindTag(heap, into, 1);
+	if(!entry) {
+		WB_ALLOC_ERROR_HANDLER("couldn't create the tag to merge into", 
+				heap, heap->name);
+		return;
+	}
+
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	/* Pops and temp scopes rewind the newest block, which the merged ones 
+	 * would sit under */
+	if(entry->flags & (wb_Arena_Stack | wbi__TaggedTagTemp)) {
+		WB_ALLOC_ERROR_HANDLER("can't merge into a stack tag or a tag in a "
+				"temp scope", heap, heap->name);
+		return;
+	}
+	/* Stack footers, extended info and temp marks only make sense in a 
+	 * tag that's laid out the same way all the way through */
+	if(fromEntry->flags != entry->flags) {
+		WB_ALLOC_ERROR_HANDLER("can't merge tags with different modes", 
+				heap, heap->name);
+		return;
+	}
+#endif
+
+	if(!wbi__taggedDetachTag(heap, from, &detached)) return;
+	wbi__traced(wbi__traceTagged(heap, wb_Trace_TaggedMerge, from, 
+				(wb_usize)into));
+
+	/* NOTE(will): the merged blocks go after into's, so into's current 
+	 * block stays current. Their tag fields still say from, but nothing 
+	 * reads those except for debugging. With best fit on, from's bins are
+	 * spliced onto the ends of into's, a bin at a time, and from's current
+	 * block (which was never binned) goes in on its own, so their leftover
+	 * room gets used without walking the blocks */
+	binned = (heap->flags & wb_TaggedHeap_SearchForBestFit) && 
+		!(heap->flags & wb_TaggedHeap_FixedSize) && !entry->flags;
+	if(detached.blocks) {
+		if(entry->blocks) {
+			entry->tail->next = detached.blocks;
+			if(binned) {
+				wbi__taggedBinBlock(heap, entry, detached.blocks);
+			}
+		} else {
+			entry->blocks = detached.blocks;
+		}
+		entry->tail = detached.tail;
+		entry->blockCount += detached.blockCount;
+	}
+
+	if(detached.bins) {
+		bins = entry->bins;
+		if(binned && !bins) {
+			entry->bins = detached.bins;
+			detached.bins = NULL;
+		} else if(binned) {
+			for(bin = 0; bin < wbi__TaggedHeapBinCount; ++bin) {
+				if(!detached.bins->heads[bin]) continue;
+				if(bins->heads[bin]) {
+					bins->tails[bin]->binNext = detached.bins->heads[bin];
+					detached.bins->heads[bin]->binPrev = bins->tails[bin];
+				} else {
+					bins->heads[bin] = detached.bins->heads[bin];
+				}
+				bins->tails[bin] = detached.bins->tails[bin];
+			}
+			bins->mask |= detached.bins->mask;
+		}
+		if(detached.bins) {
+			wb_poolRelease(heap->binPool, detached.bins);
+		}
+	}
+
+	if(detached.large) {
+		if(entry->large) {
+			entry->largeTail->next = detached.large;
+		} else {
+			entry->large = detached.large;
+		}
+		entry->largeTail = detached.largeTail;
+	}
+}
+
+WB_ALLOC_API
+void* wbi__taggedAllocLarge(wb_TaggedHeap* heap, 
+		wbi__TaggedHeapTag* entry, wb_usize size)
+{
+	wbi__TaggedHeapArena* block;
+	wb_usize mapSize;
+
+	if(heap->flags & wb_TaggedHeap_FixedSize) {
+		WB_ALLOC_ERROR_HANDLER("cannot allocate an object larger than the "
+				"size of a tagged heap arena.",
+				heap, heap->name);
+		return NULL;
+	}
+
+	mapSize = wb_alignTo(sizeof(wbi__TaggedHeapArena) + size, 
+			heap->pool.alloc->info.pageSize);
+	block = (wbi__TaggedHeapArena*)wbi__allocateVirtualSpace(mapSize);
+	if(!block || !wbi__commitMemory(block, mapSize, 
+				heap->pool.alloc->info.commitFlags)) {
+		WB_ALLOC_ERROR_HANDLER("failed to map a large allocation", 
+				heap, heap->name);
+		return NULL;
+	}
+	wbi__stat(wbi__taggedAdd(heap, &heap->stats.commits, 1));
+
+	/* NOTE(will): fresh pages are already zero. Large blocks live on their
+	 * own list, so small allocations never look at them, and end doubles as
+	 * the size of the mapping for when we unmap it */
+	block->tag = entry->tag;
+	block->flags = wbi__TaggedBlockLarge;
+	block->end = (char*)block + mapSize;
+	block->head = block->end;
+
+	/* Same as taggedLinkBlock, the tail goes in with the head */
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinLock(&heap->tagLock);
+	}
+	block->next = entry->large;
+	if(!block->next) {
+		entry->largeTail = block;
+	}
+	entry->large = block;
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinUnlock(&heap->tagLock);
+	}
+
+	return &block->buffer;
+}
+
+WB_ALLOC_API
+void wb_taggedSetMode(wb_TaggedHeap* heap, wb_isize tag, wb_iflags flags)
+{
+	wbi__TaggedHeapTag* entry;
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		WB_ALLOC_ERROR_HANDLER("can't set tag modes on a concurrent heap",
+				heap, heap->name);
+		return;
+	}
+	if(flags & ~(wb_Arena_Stack | wb_Arena_Extended)) {
+		WB_ALLOC_ERROR_HANDLER("tags only have the ArenaStack and "
+				"ArenaExtended modes", heap, heap->name);
+		return;
+	}
+#endif
+
+	entry = wbi__taggedFindTag(heap, tag, 1);
+	if(!entry) return;
+
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(entry->blocks || entry->large) {
+		WB_ALLOC_ERROR_HANDLER("can only set the mode of an empty tag",
+				heap, heap->name);
+		return;
+	}
+#endif
+	entry->flags = (entry->flags & wbi__TaggedTagTemp) | flags;
+}
+
+WB_ALLOC_API
+void* wb_taggedAllocEx(wb_TaggedHeap* heap, wb_isize tag, wb_usize size, 
+		wb_usize align, WB_ALLOC_EXTENDED_INFO extended)
+{
+	wbi__TaggedHeapTag* entry;
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		WB_ALLOC_ERROR_HANDLER("can't use taggedAllocEx on a concurrent heap",
+				heap, heap->name);
+		return NULL;
+	}
+#endif
+	entry = wbi__taggedFindTag(heap, tag, 1);
+	if(!entry) return NULL;
+	wbi__stat(heap->stats.allocs++);
+	wbi__stat(heap->stats.bytes += size);
+	wbi__traced(wbi__traceTagged(heap, wb_Trace_TaggedAlloc, tag, size));
+	return wbi__taggedAllocEx(heap, entry, size, align, extended);
+}
+
+WB_ALLOC_API
+void* wbi__taggedAllocEx(wb_TaggedHeap* heap, wbi__TaggedHeapTag* entry, 
+		wb_usize size, wb_usize align, WB_ALLOC_EXTENDED_INFO extended)
+{
+	wbi__TaggedHeapArena* block;
+	wb_usize header, footer, padded, start, end;
+
+	header = (entry->flags & wb_Arena_Extended) ? 
+		sizeof(WB_ALLOC_EXTENDED_INFO) : 0;
+	footer = (entry->flags & wb_Arena_Stack) ? 
+		sizeof(WB_ALLOC_STACK_PTR) : 0;
+	if(align < heap->align) align = heap->align;
+
+	/* NOTE(will): heads are always heap->align aligned, so this is as much
+	 * room as the allocation could possibly take up */
+	padded = size + header + footer + (align - heap->align);
+	if(padded > heap->arenaSize) {
+		if(entry->flags & wb_Arena_Stack) {
+			WB_ALLOC_ERROR_HANDLER("stack tags can't hold allocations "
+					"bigger than the arenaSize", heap, heap->name);
+			return NULL;
+		}
+		start = (wb_usize)wbi__taggedAllocLarge(heap, entry, padded);
+		if(!start) return NULL;
+		start = wb_alignTo(start + header, align);
+		if(header) {
+			((WB_ALLOC_EXTENDED_INFO*)start)[-1] = extended;
+		}
+		return (void*)start;
+	}
+
+	block = entry->blocks;
+	start = 0;
+	end = 0;
+	if(block) {
+		start = wb_alignTo((wb_isize)block->head + header, align);
+		end = wb_alignTo(start + size + footer, heap->align);
+	}
+
+	/* Stack pops and temp scopes rewind the newest block, so we always 
+	 * allocate at its end, or start another one */
+	if(!block || end > (wb_usize)block->end) {
+		block = wbi__taggedNextBlock(heap, entry, padded);
+		if(!block) {
+			WB_ALLOC_ERROR_HANDLER("tagged heap arena retrieve returned null",
+					heap, heap->name);
+			return NULL;
+		}
+		wbi__taggedLinkBlock(heap, entry, block);
+		start = wb_alignTo((wb_isize)block->head + header, align);
+		end = wb_alignTo(start + size + footer, heap->align);
+	}
+
+	if(header) {
+		((WB_ALLOC_EXTENDED_INFO*)start)[-1] = extended;
+	}
+	if(footer) {
+		((WB_ALLOC_STACK_PTR*)end)[-1] = (WB_ALLOC_STACK_PTR)block->head;
+	}
+	block->head = (void*)end;
+	return (void*)start;
+}
+
+WB_ALLOC_API
+void wb_taggedPop(wb_TaggedHeap* heap, wb_isize tag)
+{
+	wbi__TaggedHeapTag* entry;
+	wbi__TaggedHeapArena* block;
+	void* newHead;
+
+	entry = wbi__taggedFindTag(heap, tag, 0);
+	if(!entry) return;
+
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(!(entry->flags & wb_Arena_Stack)) {
+		WB_ALLOC_ERROR_HANDLER("can't use taggedPop on a tag that isn't in "
+				"stack mode", heap, heap->name);
+		return;
+	}
+#endif
+
+	block = entry->blocks;
+	if(!block || block->head == (void*)&block->buffer) return;
+
+	newHead = (void*)((WB_ALLOC_STACK_PTR*)block->head)[-1];
+	if(!(heap->flags & wb_TaggedHeap_NoZeroMemory)) {
+		WB_ALLOC_MEMSET(newHead, 0, 
+				(wb_isize)block->head - (wb_isize)newHead);
+	}
+	block->head = newHead;
+
+	/* Once the newest block is empty, it goes back, and the one before it
+	 * (which ends in the allocation before this) is on top again. That 
+	 * takes a TaggedPool's elements with it, same as a free, but a pop 
+	 * that stays in the block only costs the pools what was popped */
+	if(newHead == (void*)&block->buffer && block != entry->tempBlock) {
+		entry->blocks = block->next;
+		entry->blockCount--;
+		if(!entry->blocks) {
+			entry->tail = NULL;
+		}
+		wbi__taggedReleaseBlocks(heap, block, block, 1);
+		entry->generation = wbi__taggedAdd(heap, &heap->nextGeneration, 1);
+		entry->rewindBlock = NULL;
+	} else {
+		wbi__taggedRewound(entry, block, newHead);
+	}
+}
+
+WB_ALLOC_API
+void wb_taggedStartTemp(wb_TaggedHeap* heap, wb_isize tag)
+{
+	wbi__TaggedHeapTag* entry;
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		WB_ALLOC_ERROR_HANDLER("can't use temp scopes on a concurrent heap",
+				heap, heap->name);
+		return;
+	}
+#endif
+
+	entry = wbi__taggedFindTag(heap, tag, 1);
+	if(!entry || (entry->flags & wbi__TaggedTagTemp)) return;
+	entry->flags |= wbi__TaggedTagTemp;
+	entry->tempBlock = entry->blocks;
+	entry->tempHead = entry->blocks ? entry->blocks->head : NULL;
+	entry->tempLarge = entry->large;
+}
+
+WB_ALLOC_API
+void wb_taggedEndTemp(wb_TaggedHeap* heap, wb_isize tag)
+{
+	wbi__TaggedHeapTag* entry;
+	wbi__TaggedHeapArena *block, *first, *last, *next;
+	wb_isize count;
+
+	entry = wbi__taggedFindTag(heap, tag, 0);
+	if(!entry || !(entry->flags & wbi__TaggedTagTemp)) return;
+
+	/* Everything newer than the blocks we started with is on top of them, 
+	 * so it all comes off the front of the lists */
+	first = entry->blocks;
+	last = NULL;
+	count = 0;
+	for(block = first; block != entry->tempBlock; block = block->next) {
+		last = block;
+		count++;
+	}
+	if(last) {
+		entry->blocks = entry->tempBlock;
+		entry->blockCount -= count;
+		if(!entry->blocks) {
+			entry->tail = NULL;
+		}
+		wbi__taggedReleaseBlocks(heap, first, last, count);
+	}
+	if(last || entry->large != entry->tempLarge) {
+		entry->generation = wbi__taggedAdd(heap, &heap->nextGeneration, 1);
+		entry->rewindBlock = NULL;
+	}
+
+	block = entry->large;
+	while(block != entry->tempLarge) {
+		next = block->next;
+		wbi__freeAddressSpace(block, (wb_usize)block->end - (wb_usize)block);
+		block = next;
+	}
+	entry->large = entry->tempLarge;
+	if(!entry->large) {
+		entry->largeTail = NULL;
+	}
+
+	/* NOTE(will): a taggedPop in the scope can take the head back past 
+	 * where the scope started, and then it's already zeroed what's past 
+	 * it, so there's nothing to give back (and the head stays put) */
+	block = entry->tempBlock;
+	if(block && (char*)block->head > (char*)entry->tempHead) {
+		if(!(heap->flags & wb_TaggedHeap_NoZeroMemory)) {
+			WB_ALLOC_MEMSET(entry->tempHead, 0, 
+					(wb_isize)block->head - (wb_isize)entry->tempHead);
+		}
+		block->head = entry->tempHead;
+		wbi__taggedRewound(entry, block, block->head);
+	}
+
+	entry->flags &= ~wbi__TaggedTagTemp;
+	entry->tempBlock = NULL;
+	entry->tempLarge = NULL;
+	entry->tempHead = NULL;
+}
+
+WB_ALLOC_API
+void wbi__taggedRewound(wbi__TaggedHeapTag* entry, 
+		wbi__TaggedHeapArena* block, void* head)
+{
+	/* NOTE(will): we only keep the lowest point the tag's been rewound 
+	 * to since its generation last changed. Any block newer than that one
+	 * was made after it, so it's all above that point anyway */
+	if(!entry->rewindBlock || (entry->rewindBlock == block && 
+				(char*)head < (char*)entry->rewindHead)) {
+		entry->rewindBlock = block;
+		entry->rewindHead = head;
+	}
+	entry->rewinds++;
+}
+
+WB_ALLOC_API
+void wb_taggedRetire(wb_TaggedHeap* heap, wb_isize tag, 
+		volatile wb_usize* counter, wb_usize target)
+{
+	wbi__TaggedHeapRetired *retired, oldest;
+
+	/* NOTE(will): a full ring means the pipeline is deeper than we have 
+	 * room for, so there's nothing to do but wait on the oldest frame. 
+	 * Collecting takes the lock itself, so we let go while we wait and 
+	 * check again once we have it back, since another thread might have 
+	 * filled the slot we made */
+	for(;;) {
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			wbi__spinLock(&heap->retireLock);
+		}
+		if(heap->retiredCount < WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT) break;
+		oldest = heap->retired[0];
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			wbi__spinUnlock(&heap->retireLock);
+		}
+		if(!wb_taggedFrameCollect(heap)) {
+			while(oldest.counter && *oldest.counter < oldest.target);
+		}
+	}
+
+	retired = heap->retired + heap->retiredCount++;
+	retired->tag = tag;
+	retired->counter = counter;
+	retired->target = target;
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinUnlock(&heap->retireLock);
+	}
+}
+
+WB_ALLOC_API
+wb_isize wb_taggedFrameCollect(wb_TaggedHeap* heap)
+{
+	wbi__TaggedHeapRetired* retired;
+	wb_isize i, kept, freed;
+
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinLock(&heap->retireLock);
+	}
+
+	/* Counters can finish out of order, so check them all, keeping the 
+	 * ones still waiting in retirement order */
+	kept = 0;
+	freed = 0;
+	for(i = 0; i < heap->retiredCount; ++i) {
+		retired = heap->retired + i;
+		if(!retired->counter || *retired->counter >= retired->target) {
+			wb_taggedFree(heap, retired->tag);
+			freed++;
+		} else {
+			heap->retired[kept++] = *retired;
+		}
+	}
+	heap->retiredCount = kept;
+
+	if(heap->flags & wb_TaggedHeap_Concurrent) {
+		wbi__spinUnlock(&heap->retireLock);
+	}
+	return freed;
+}
+
+WB_ALLOC_API
+wb_isize wb_taggedFrameTag(wb_TaggedHeap* heap)
+{
+	return WB_ALLOC_TAGGEDHEAP_FRAME_TAG_BASE + heap->frame;
+}
+
+WB_ALLOC_API
+wb_isize wb_taggedFrameAdvance(wb_TaggedHeap* heap, 
+		volatile wb_usize* counter, wb_usize target)
+{
+	wb_isize tag;
+
+	wb_taggedRetire(heap, wb_taggedFrameTag(heap), counter, target);
+	wb_taggedFrameCollect(heap);
+
+	/* The frame this slot last held is a whole retire ring behind us, so 
+	 * it's been freed, and the slot is ours to take over */
+	tag = WB_ALLOC_TAGGEDHEAP_FRAME_TAG_BASE + heap->frame + 1;
+	wbi__taggedInitTag(heap, 
+			heap->tags + WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT + 
+			(heap->frame + 1) % wbi__TaggedHeapFrameCount, tag);
+	heap->frame++;
+	return tag;
+}
+
+WB_ALLOC_API
+void wb_taggedPoolInit(wb_TaggedPool* pool, wb_TaggedHeap* heap, 
+		wb_isize tag, wb_usize elementSize)
+{
+#ifndef WB_ALLOC_NO_ZERO_ON_INIT
+	WB_ALLOC_MEMSET(pool, 0, sizeof(wb_TaggedPool));
+#endif
+	pool->name = "taggedPool";
+	pool->heap = heap;
+	pool->tag = tag;
+	if(elementSize < sizeof(void*)) {
+		elementSize = sizeof(void*);
+	}
+	pool->elementSize = wb_alignTo(elementSize, heap->align);
+	pool->freeList = NULL;
+	pool->entry = NULL;
+	pool->generation = 0;
+	pool->rewinds = 0;
+	pool->count = 0;
+}
+
+WB_ALLOC_API
+void* wb_taggedPoolRetrieve(wb_TaggedPool* pool)
+{
+	wbi__TaggedHeapTag* entry;
+	void* ptr;
+
+	/* NOTE(will): if the tag's been freed since we last looked, so has 
+	 * everything on the free list. Tag entries are never unmapped, so the 
+	 * old one is still safe to read, even if it's been reused since */
+	entry = pool->entry;
+	if(!entry || entry->generation != pool->generation) {
+		entry = wbi__taggedFindTag(pool->heap, pool->tag, 1);
+		if(!entry) return NULL;
+		pool->entry = entry;
+		pool->generation = entry->generation;
+		pool->rewinds = entry->rewinds;
+		pool->freeList = NULL;
+		pool->count = 0;
+	} else if(entry->rewinds != pool->rewinds) {
+		wbi__taggedPoolTrim(pool);
+	}
+
+	if(pool->freeList) {
+		ptr = pool->freeList;
+		pool->freeList = (void**)*pool->freeList;
+		if(!(pool->heap->flags & wb_TaggedHeap_NoZeroMemory)) {
+			WB_ALLOC_MEMSET(ptr, 0, pool->elementSize);
+		}
+	} else {
+		ptr = wb_taggedAlloc(pool->heap, pool->tag, pool->elementSize);
+		if(!ptr) return NULL;
+	}
+
+	pool->count++;
+	return ptr;
+}
+
+WB_ALLOC_API
+void wb_taggedPoolRelease(wb_TaggedPool* pool, void* ptr)
+{
+	if(!ptr) return;
+	/* Anything from before the tag was freed is already gone */
+	if(!pool->entry || pool->entry->generation != pool->generation) {
+		WB_ALLOC_ERROR_HANDLER("can't release an element from before its "
+				"tag was freed", pool, pool->name);
+		return;
+	}
+	if(pool->entry->rewinds != pool->rewinds) {
+		wbi__taggedPoolTrim(pool);
+	}
+	*(void**)ptr = (void*)pool->freeList;
+	pool->freeList = (void**)ptr;
+	pool->count--;
+}
+
+WB_ALLOC_API
+void wbi__taggedPoolTrim(wb_TaggedPool* pool)
+{
+	wbi__TaggedHeapTag* entry;
+	wbi__TaggedHeapArena* block;
+	void** link;
+	char* ptr;
+
+	/* NOTE(will): the free list is threaded through the elements, so 
+	 * the links past the first rewound one could be anything and the 
+	 * list has to be cut there. What's cut off is lost until the tag's 
+	 * freed, which is no worse than what a rewind does anyway */
+	entry = pool->entry;
+	for(link = (void**)&pool->freeList; *link; link = (void**)*link) {
+		ptr = (char*)*link;
+		for(block = entry->blocks; block != entry->rewindBlock; 
+				block = block->next) {
+			if(ptr >= (char*)&block->buffer && ptr < (char*)block->end) break;
+		}
+		if(block != entry->rewindBlock || (ptr >= (char*)entry->rewindHead &&
+					ptr < (char*)block->end)) {
+			*link = NULL;
+			break;
+		}
+	}
+	pool->rewinds = entry->rewinds;
+}
+
+WB_ALLOC_API
+void wb_taggedThreadInit(wb_TaggedHeapThread* thread, wb_TaggedHeap* heap)
+{
+#ifndef WB_ALLOC_NO_ZERO_ON_INIT
+	WB_ALLOC_MEMSET(thread, 0, sizeof(wb_TaggedHeapThread));
+#endif
+	thread->heap = heap;
+}
+
+WB_ALLOC_API
+void* wb_taggedThreadAlloc(wb_TaggedHeapThread* thread, 
+		wb_isize tag, wb_usize size)
+{
+	wbi__TaggedHeapArena* block;
+	wb_usize slot;
+	void* oldHead;
+
+	wbi__traced(wbi__traceTagged(thread->heap, wb_Trace_TaggedAlloc, 
+				tag, size));
+	slot = (wb_usize)tag & (WB_ALLOC_TAGGEDHEAP_THREAD_CACHE_SIZE - 1);
+	block = thread->blocks[slot];
+	if(block && thread->tags[slot] == tag && 
+			thread->generations[slot] == thread->entries[slot]->generation &&
+			(char*)block->head + size <= (char*)block->end) {
+		oldHead = block->head;
+		block->head = (void*)wb_alignTo((wb_isize)block->head + size, 
+				thread->heap->align);
+		wbi__stat(thread->allocs++);
+		wbi__stat(thread->bytes += size);
+		return oldHead;
+	}
+
+	return wbi__taggedThreadAllocSlow(thread, tag, size);
+}
+
+WB_ALLOC_API
+void* wbi__taggedThreadAllocSlow(wb_TaggedHeapThread* thread, 
+		wb_isize tag, wb_usize size)
+{
+	wb_TaggedHeap* heap = thread->heap;
+	wbi__TaggedHeapArena* block;
+	wbi__TaggedHeapTag* entry;
+	wb_usize slot, generation;
+	void* oldHead;
+
+#ifdef WB_ALLOC_STATS
+	/* The fast path only counts locally; hand it over to the heap here */
+	wbi__atomicAdd(&heap->stats.allocs, thread->allocs + 1);
+	wbi__atomicAdd(&heap->stats.bytes, thread->bytes + size);
+	thread->allocs = 0;
+	thread->bytes = 0;
+#endif
+
+	entry = wbi__taggedFindTag(heap, tag, 1);
+	if(!entry) return NULL;
+
+	if(size > heap->arenaSize) {
+		return wbi__taggedAllocLarge(heap, entry, size);
 	}
 
-	if(pool->flags & wb_Pool_Compacting) {
-		WB_ALLOC_MEMCPY(ptr, 
-				(char*)pool->slots + pool->count * pool->elementSize,
-				pool->elementSize);
-		return;
+	/* NOTE(will): read the generation before linking the block in, so that
+	 * if the tag gets freed in between, we see a stale block, not a live 
+	 * one that's already back on the free stack */
+	generation = entry->generation;
+	block = wbi__taggedNextBlock(heap, entry, size);
+	if(!block) {
+		WB_ALLOC_ERROR_HANDLER("tagged heap arena retrieve returned null",
+				heap, heap->name);
+		return NULL;
 	}
+	wbi__taggedLinkBlock(heap, entry, block);
 
-	*(void**)ptr = pool->freeList;
-	pool->freeList = (void**)ptr;
+	slot = (wb_usize)tag & (WB_ALLOC_TAGGEDHEAP_THREAD_CACHE_SIZE - 1);
+	thread->tags[slot] = tag;
+	thread->generations[slot] = generation;
+	thread->entries[slot] = entry;
+	thread->blocks[slot] = block;
+
+	oldHead = block->head;
+	block->head = (void*)wb_alignTo((wb_isize)block->head + size, heap->align);
+	return oldHead;
 }
 
-/*
- * TODO(will): Maybe, someday, have a tagged heap that uses real memoryArenas
- * 	behind the scenes, so that you get to benefit from stack and extended 
- * 	mode for ~free; maybe as a preprocessor flag?
- */ 
+/* Allocator Statistics */
+#ifdef WB_ALLOC_STATS
 WB_ALLOC_API
-wb_isize wb_calcTaggedHeapSize(wb_isize arenaSize, wb_isize arenaCount,
-		wb_iflags bootstrapped)
+void wbi__poolStatRetrieve(wb_MemoryPool* pool, wb_isize n, wb_usize zeroed)
 {
-	return arenaCount * (arenaSize + sizeof(wbi__TaggedHeapArena))
-		+ sizeof(wb_TaggedHeap) * bootstrapped;
+	wb_usize live;
+	pool->stats.allocs += n;
+	pool->stats.bytes += n * pool->elementSize;
+	pool->stats.zeroedBytes += zeroed;
+	live = (wb_usize)pool->count * pool->elementSize;
+	if(live > pool->stats.highWater) {
+		pool->stats.highWater = live;
+	}
 }
 
 WB_ALLOC_API
-void wb_taggedInit(wb_TaggedHeap* heap, wb_MemoryArena* arena, 
-		wb_isize internalArenaSize, wb_iflags flags)
+void wbi__statPages(wb_AllocStats* stats, wb_isize released)
 {
-#ifndef WB_ALLOC_NO_ZERO_ON_INIT
-	WB_ALLOC_MEMSET(heap, 0, sizeof(wb_TaggedHeap));
+	/* Dropping pages is a decommit and then a commit */
+	if(released > 0) {
+		stats->decommits++;
+		stats->commits++;
+	}
+}
 #endif
 
-	heap->name = "taggedHeap";
-	heap->flags = flags;
-	heap->align = 8;
-	heap->arenaSize = internalArenaSize;
-	wb_poolInit(&heap->pool, arena, 
-			internalArenaSize + sizeof(wbi__TaggedHeapArena), 
-			wb_Pool_Normal | wb_Pool_NoDoubleFreeCheck | 
-			((flags & wb_TaggedHeap_NoZeroMemory) ? 
-			wb_Pool_NoZeroMemory : 
-			0));
+WB_ALLOC_API
+void wb_arenaStats(wb_MemoryArena* arena, wb_AllocStats* stats)
+{
+	WB_ALLOC_MEMSET(stats, 0, sizeof(wb_AllocStats));
+#ifdef WB_ALLOC_STATS
+	*stats = arena->stats;
+#endif
+	stats->name = arena->name;
+	stats->kind = wb_Stats_Arena;
+	stats->used = (wb_usize)arena->head - (wb_usize)arena->start;
+	stats->committed = (wb_usize)arena->end - (wb_usize)arena->start;
+	if(stats->used > stats->highWater) {
+		stats->highWater = stats->used;
+	}
 }
 
 WB_ALLOC_API
-wb_TaggedHeap* wb_taggedBootstrap(wb_MemoryInfo info, 
-		wb_isize arenaSize,
-		wb_iflags flags)
+void wb_poolStats(wb_MemoryPool* pool, wb_AllocStats* stats)
 {
-	wb_TaggedHeap* strapped;
-	wb_TaggedHeap heap;
-	wb_MemoryArena* arena;
-	info.commitSize = wb_calcTaggedHeapSize(arenaSize, 8, 1);
-	arena = wb_arenaBootstrap(info, 
-			((flags & wb_TaggedHeap_NoZeroMemory) ? 
-			wb_Arena_NoZeroMemory :
-			wb_Arena_Normal));
-	strapped = (wb_TaggedHeap*)wb_arenaPush(arena, sizeof(wb_TaggedHeap) + 16);
-	wb_taggedInit(&heap, arena, arenaSize, flags);
-	*strapped = heap;
-	return strapped;
+	WB_ALLOC_MEMSET(stats, 0, sizeof(wb_AllocStats));
+#ifdef WB_ALLOC_STATS
+	*stats = pool->stats;
+	/* NOTE(will): count only goes down by releasing, so this is exact */
+	stats->frees = stats->allocs - (wb_usize)pool->count;
+	stats->commits += pool->alloc->stats.commits;
+	stats->decommits += pool->alloc->stats.decommits;
+#endif
+	stats->name = pool->name;
+	stats->kind = wb_Stats_Pool;
+	stats->used = (wb_usize)pool->count * pool->elementSize;
+	stats->committed = (wb_usize)pool->alloc->end - (wb_usize)pool->slots;
+	if(stats->used > stats->highWater) {
+		stats->highWater = stats->used;
+	}
+	if(!(pool->flags & (wb_Pool_Compacting | wb_Pool_PageSlots))) {
+		stats->freeListLength = pool->lastFilled + 1 - pool->count - 
+			pool->unlisted;
+	}
 }
 
 WB_ALLOC_API
-wb_TaggedHeap* wb_taggedFixedSizeBootstrap(
-		wb_isize arenaSize, 
-		void* buffer, wb_isize bufferSize, 
-		wb_iflags flags)
+void wbi__taggedTagStats(wbi__TaggedHeapTag* entry, wb_AllocStats* stats,
+		wb_isize countBlocks)
 {
-	wb_MemoryArena* alloc;
-	wb_TaggedHeap* heap;
-	flags |= wb_TaggedHeap_FixedSize;
-	
-	alloc = arenaFixedSizeBootstrap(buffer, bufferSize, 
-			wb_Arena_FixedSize |
-			((flags & wb_TaggedHeap_NoZeroMemory) ? 
-			wb_Arena_NoZeroMemory : 0));
-	heap = (wb_TaggedHeap*)wb_arenaPush(alloc, sizeof(wb_TaggedHeap));
+	wbi__TaggedHeapArena* block;
 
-	wb_taggedInit(heap, alloc, arenaSize, flags);
-	return heap;
-	
+	for(block = entry->blocks; block; block = block->next) {
+		stats->used += (wb_usize)block->head - (wb_usize)&block->buffer;
+		if(countBlocks) {
+			stats->committed += (wb_usize)block->end - (wb_usize)block;
+		}
+	}
+	for(block = entry->large; block; block = block->next) {
+		stats->used += (wb_usize)block->end - (wb_usize)&block->buffer;
+		stats->committed += (wb_usize)block->end - (wb_usize)block;
+	}
+	stats->blockCount += (wb_isize)entry->blockCount;
+	if(entry->blocks || entry->large) {
+		stats->tagCount++;
+	}
 }
 
 WB_ALLOC_API
-void wbi__taggedArenaInit(wb_TaggedHeap* heap, 
-		wbi__TaggedHeapArena* arena,
-		wb_isize tag)
+void wb_taggedStats(wb_TaggedHeap* heap, wb_AllocStats* stats)
 {
-#ifndef WB_ALLOC_NO_ZERO_ON_INIT
-	WB_ALLOC_MEMSET(arena, 0, sizeof(wbi__TaggedHeapArena));
+	wbi__TaggedHeapTag* entry;
+	wb_isize i;
+
+	WB_ALLOC_MEMSET(stats, 0, sizeof(wb_AllocStats));
+#ifdef WB_ALLOC_STATS
+	*stats = heap->stats;
+	stats->commits += heap->pool.alloc->stats.commits;
+	stats->decommits += heap->pool.alloc->stats.decommits;
+	stats->zeroedBytes += heap->pool.stats.zeroedBytes;
 #endif
+	stats->name = heap->name;
+	stats->kind = wb_Stats_TaggedHeap;
+
+	/* NOTE(will): the blocks all live in the pool, so they're counted once
+	 * from there; large blocks are their own mappings, so the tags add 
+	 * those as they go */
+	stats->committed = (wb_usize)heap->pool.alloc->end - 
+		(wb_usize)heap->pool.slots;
+	for(i = 0; i < WB_ALLOC_TAGGEDHEAP_MAX_TAG_COUNT + 
+			wbi__TaggedHeapFrameCount; ++i) {
+		wbi__taggedTagStats(heap->tags + i, stats, 0);
+	}
+	if(heap->buckets) {
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			wbi__spinLock(&heap->tagLock);
+		}
+		for(i = 0; i < heap->bucketCount; ++i) {
+			for(entry = heap->buckets[i]; entry; entry = entry->next) {
+				wbi__taggedTagStats(entry, stats, 0);
+			}
+		}
+		if(heap->flags & wb_TaggedHeap_Concurrent) {
+			wbi__spinUnlock(&heap->tagLock);
+		}
+	}
 
-	arena->tag = tag;
-	arena->head = &arena->buffer;
-	arena->end = (void*)((char*)arena->head + heap->arenaSize);
+	/* Blocks are only carved when there aren't any free ones, so the pool
+	 * is as big as the most the tags ever held at once */
+	stats->highWater = (wb_usize)heap->pool.count * heap->pool.elementSize;
+	stats->freeListLength = (wb_isize)heap->hotBlockCount;
 }
 
 WB_ALLOC_API
-void wbi__taggedArenaSortBySize(wbi__TaggedHeapArena** array, wb_isize count)
+void wb_taggedTagStats(wb_TaggedHeap* heap, wb_isize tag, 
+		wb_AllocStats* stats)
 {
-#define wbi__arenaSize(arena) ((wb_isize)arena->head - (wb_isize)arena->head)
-	wb_isize i, j, minSize;
-	for(i = 1; i < count; ++i) {
-		j = i - 1;
-
-		minSize = wbi__arenaSize(array[i]);
-		if(wbi__arenaSize(array[j]) > minSize) {
-			wbi__TaggedHeapArena* temp = array[i];
-			while((j >= 0) && (wbi__arenaSize(array[j]) > minSize)) {
-				array[j + 1] = array[j];
-				j--;
-			}
-			array[j + 1] = temp;
-		}
-	}
-#undef wbi__arenaSize
+	wbi__TaggedHeapTag* entry;
+
+	WB_ALLOC_MEMSET(stats, 0, sizeof(wb_AllocStats));
+	stats->name = heap->name;
+	stats->kind = wb_Stats_TaggedHeap;
+	entry = wbi__taggedFindTag(heap, tag, 0);
+	if(!entry) return;
+	wbi__taggedTagStats(entry, stats, 1);
+	stats->highWater = stats->used;
 }
 
+/* NOTE(will): this is the only global state in the library, and it's only
+ * touched by the functions below */
+typedef struct wbi__StatsRegistry wbi__StatsRegistry;
+struct wbi__StatsRegistry
+{
+	void* allocators[WB_ALLOC_STATS_REGISTRY_SIZE];
+	wb_isize kinds[WB_ALLOC_STATS_REGISTRY_SIZE];
+	wb_isize count;
+	volatile wb_usize lock;
+};
+
+static wbi__StatsRegistry wbi__statsRegistry;
 
 WB_ALLOC_API
-void* wb_taggedAlloc(wb_TaggedHeap* heap, wb_isize tag, wb_usize size)
+wb_isize wb_statsRegister(void* allocator, wb_isize kind)
 {
-	wbi__TaggedHeapArena *arena, *newArena;
-	void* oldHead;
-	wbi__TaggedHeapArena* canFit[wbi__TaggedHeapSearchSize];
-	wb_isize canFitCount = 0;
+	wbi__StatsRegistry* registry = &wbi__statsRegistry;
 
-	if(size > heap->arenaSize) {
-		WB_ALLOC_ERROR_HANDLER("cannot allocate an object larger than the "
-				"size of a tagged heap arena.",
-				heap, heap->name);
-		return NULL;
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(kind < wb_Stats_Arena || kind > wb_Stats_TaggedHeap) {
+		WB_ALLOC_ERROR_HANDLER("statsRegister needs one of wb_Stats_Arena, "
+				"wb_Stats_Pool or wb_Stats_TaggedHeap", 
+				allocator, "stats");
+		return 0;
 	}
+#endif
 
-	if(!heap->arenas[tag]) {
-		heap->arenas[tag] = (wbi__TaggedHeapArena*)wb_poolRetrieve(&heap->pool);
-		if(!heap->arenas[tag]) {
-			WB_ALLOC_ERROR_HANDLER("tagged heap arena retrieve returned null "
-					"when creating a new tag",
-				heap, heap->name);
-			return NULL;
+	wbi__spinLock(&registry->lock);
+	if(registry->count >= WB_ALLOC_STATS_REGISTRY_SIZE) {
+		wbi__spinUnlock(&registry->lock);
+		WB_ALLOC_ERROR_HANDLER("the stats registry is full; "
+				"raise WB_ALLOC_STATS_REGISTRY_SIZE", 
+				allocator, "stats");
+		return 0;
+	}
+	registry->allocators[registry->count] = allocator;
+	registry->kinds[registry->count] = kind;
+	registry->count++;
+	wbi__spinUnlock(&registry->lock);
+	return 1;
+}
+
+WB_ALLOC_API
+void wb_statsUnregister(void* allocator)
+{
+	wbi__StatsRegistry* registry = &wbi__statsRegistry;
+	wb_isize i;
+
+	wbi__spinLock(&registry->lock);
+	for(i = 0; i < registry->count; ++i) {
+		if(registry->allocators[i] == allocator) {
+			registry->count--;
+			registry->allocators[i] = registry->allocators[registry->count];
+			registry->kinds[i] = registry->kinds[registry->count];
+			break;
 		}
-		wbi__taggedArenaInit(heap, heap->arenas[tag], tag);
 	}
+	wbi__spinUnlock(&registry->lock);
+}
 
-	arena = heap->arenas[tag];
+WB_ALLOC_API
+wb_isize wb_statsCollect(wb_AllocStats* out, wb_isize max)
+{
+	wbi__StatsRegistry* registry = &wbi__statsRegistry;
+	wb_isize i;
+
+	wbi__spinLock(&registry->lock);
+	for(i = 0; i < registry->count && i < max; ++i) {
+		switch(registry->kinds[i]) {
+			case wb_Stats_Arena:
+				wb_arenaStats((wb_MemoryArena*)registry->allocators[i], out + i);
+				break;
+			case wb_Stats_Pool:
+				wb_poolStats((wb_MemoryPool*)registry->allocators[i], out + i);
+				break;
+			default:
+				wb_taggedStats((wb_TaggedHeap*)registry->allocators[i], out + i);
+				break;
+		}
+	}
+	wbi__spinUnlock(&registry->lock);
+	return i;
+}
 
-	if((char*)arena->head + size > (char*)arena->end) {
-		/* TODO(will) add a find-better-fit option rather than
-		 * allocating new arenas whenever */
+/* Allocation Tracing */
+#ifdef WB_ALLOC_TRACE
+static WB_ALLOC_THREAD_LOCAL wb_TraceRing* wbi__traceRing;
+static volatile wb_usize wbi__traceSequence, wbi__traceThreads;
 
-		if(heap->flags & wb_TaggedHeap_SearchForBestFit) {
-			while((arena = arena->next)) {
-				if((char*)arena->head + size < (char*)arena->end) {
-					canFit[canFitCount++] = arena;
-					if(canFitCount > (wbi__TaggedHeapSearchSize - 1)) {
-						break;
-					}
-				}
-			}
+WB_ALLOC_API
+void wbi__traceRecord(wb_isize op, void* allocator, wb_usize value, 
+		wb_isize tag, wb_usize param, wb_iflags flags)
+{
+	wb_TraceRing* ring;
+	wb_TraceRecord* record;
+	wb_usize head, sequence;
+
+	ring = wbi__traceRing;
+	if(!ring) return;
+
+	/* NOTE(will): a dropped record still takes a sequence number, so the 
+	 * replay can tell something's missing. Only this thread writes head, 
+	 * and only the reader writes tail, so there's nothing to race on but 
+	 * the slots themselves */
+	sequence = wbi__atomicAdd(&wbi__traceSequence, 1);
+	head = ring->head;
+	if(head - ring->tail >= ring->capacity) {
+		ring->dropped++;
+		return;
+	}
 
-			if(canFitCount > 0) {
-				wbi__taggedArenaSortBySize(canFit, canFitCount);
-				arena = canFit[0];
-			}
-		}
+	record = ring->records + (head & (ring->capacity - 1));
+	record->sequence = sequence;
+	record->allocator = (wb_usize)allocator;
+	record->value = value;
+	record->tag = tag;
+	record->param = param;
+	record->op = (wb_u16)op;
+	record->thread = ring->thread;
+	record->flags = (wb_u32)flags;
+
+	/* Publishing with a CAS is also the barrier that keeps the reader from
+	 * seeing the new head before the record is written */
+	wbi__atomicCas(&ring->head, head, head + 1);
+}
 
-		if(canFitCount == 0) {
-			newArena = (wbi__TaggedHeapArena*)wb_poolRetrieve(&heap->pool);
-			if(!newArena) {
-				WB_ALLOC_ERROR_HANDLER(
-						"tagged heap arena retrieve returned null",
-						heap, heap->name);
-				return NULL;
-			}
-			wbi__taggedArenaInit(heap, newArena, tag);
-			newArena->next = arena;
-			arena = newArena;
+WB_ALLOC_API
+void wbi__traceArena(wb_MemoryArena* arena, wb_isize op, wb_usize size)
+{
+	if(!(arena->flags & wb_Arena_Trace)) return;
+	wbi__traceRecord(op, arena, size, 0, arena->info.commitSize, 
+			arena->flags & ~wb_Arena_Trace);
+}
+
+WB_ALLOC_API
+void wbi__tracePool(wb_MemoryPool* pool, wb_isize op, void* ptr)
+{
+	if(!(pool->flags & wb_Pool_Trace)) return;
+	wbi__traceRecord(op, pool, (wb_usize)ptr, 0, pool->elementSize, 
+			pool->flags & ~wb_Pool_Trace);
+}
+
+WB_ALLOC_API
+void wbi__traceTagged(wb_TaggedHeap* heap, wb_isize op, 
+		wb_isize tag, wb_usize size)
+{
+	if(!(heap->flags & wb_TaggedHeap_Trace)) return;
+	wbi__traceRecord(op, heap, size, tag, heap->arenaSize, 
+			heap->flags & ~wb_TaggedHeap_Trace);
+}
+#endif
+
+WB_ALLOC_API
+void wb_traceRingInit(wb_TraceRing* ring, wb_TraceRecord* records, 
+		wb_usize capacity)
+{
+#ifndef WB_ALLOC_NO_ZERO_ON_INIT
+	WB_ALLOC_MEMSET(ring, 0, sizeof(wb_TraceRing));
+#endif
+
+#ifndef WB_ALLOC_NO_FLAG_CORRECTNESS_CHECKS
+	if(!capacity || (capacity & (capacity - 1))) {
+		WB_ALLOC_ERROR_HANDLER("a trace ring's capacity has to be a "
+				"power of two", ring, "traceRing");
+		while(capacity & (capacity - 1)) {
+			capacity &= capacity - 1;
 		}
 	}
+#endif
 
-	oldHead = arena->head;
-	arena->head = (void*)wb_alignTo((wb_isize)arena->head + size, heap->align);
-	return oldHead;
+	ring->records = records;
+	ring->capacity = capacity;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->dropped = 0;
+	ring->thread = 0;
 }
 
 WB_ALLOC_API
-void wb_taggedFree(wb_TaggedHeap* heap, wb_isize tag)
+void wb_traceAttach(wb_TraceRing* ring)
+{
+#ifdef WB_ALLOC_TRACE
+	if(ring && !ring->thread) {
+		ring->thread = (wb_u16)wbi__atomicAdd(&wbi__traceThreads, 1);
+	}
+	wbi__traceRing = ring;
+#else
+	(void)ring;
+#endif
+}
+
+WB_ALLOC_API
+wb_isize wb_traceRead(wb_TraceRing* ring, wb_TraceRecord* out, wb_isize max)
 {
-	wbi__TaggedHeapArena *head;
-	if((head = heap->arenas[tag])) do {
-		wb_poolRelease(&heap->pool, head);
-	} while((head = head->next));
-	heap->arenas[tag] = NULL;
+	wb_usize head, tail;
+	wb_isize n;
+
+	/* Adding zero is just a read with a barrier after it */
+	head = wbi__atomicAdd(&ring->head, 0);
+	tail = ring->tail;
+	for(n = 0; tail + n != head && n < max; ++n) {
+		out[n] = ring->records[(tail + n) & (ring->capacity - 1)];
+	}
+	wbi__atomicCas(&ring->tail, tail, tail + n);
+	return n;
 }
 
 #ifdef WB_ALLOC_CPLUSPLUS_FEATURES
@@ -1462,6 +6133,27 @@ void wb_poolRelease(wb_MemoryPool* pool, T* ptr)
 	wb_poolRelease(pool, reinterpret_cast<void*>(ptr));
 }
 
+template<typename T>
+WB_ALLOC_API
+wb_isize wb_poolRetrieveBatch(wb_MemoryPool* pool, T** out, wb_isize count)
+{
+	return wb_poolRetrieveBatch(pool, reinterpret_cast<void**>(out), count);
+}
+
+template<typename T>
+WB_ALLOC_API
+void wb_poolReleaseBatch(wb_MemoryPool* pool, T** ptrs, wb_isize count)
+{
+	wb_poolReleaseBatch(pool, reinterpret_cast<void**>(ptrs), count);
+}
+
+template<typename T>
+WB_ALLOC_API
+T* wb_poolIterNext(wb_PoolIterator* iter)
+{
+	return reinterpret_cast<T*>(wb_poolIterNext(iter));
+}
+
 template<typename T>
 WB_ALLOC_API 
 void wb_poolInit(
@@ -1489,12 +6181,93 @@ wb_MemoryPool* wb_poolFixedSizeBootstrap(
 	return wb_poolFixedSizeBootstrap(sizeof(T), buffer, size, flags);
 }
 
+template<typename T>
+WB_ALLOC_API
+T* wb_soaColumn(wb_SoaPool* soa, wb_isize field)
+{
+	return reinterpret_cast<T*>(wb_soaColumn(soa, field));
+}
+
+template<typename T>
+WB_ALLOC_API
+T* wb_soaField(wb_SoaPool* soa, wb_isize field, wb_isize index)
+{
+	return reinterpret_cast<T*>(wb_soaField(soa, field, index));
+}
+
+template<typename A, typename B>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags)
+{
+	wb_usize sizes[] = {sizeof(A), sizeof(B)};
+	return wb_soaBootstrap(info, sizes, 2, flags);
+}
+
+template<typename A, typename B, typename C>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags)
+{
+	wb_usize sizes[] = {sizeof(A), sizeof(B), sizeof(C)};
+	return wb_soaBootstrap(info, sizes, 3, flags);
+}
+
+template<typename A, typename B, typename C, typename D>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags)
+{
+	wb_usize sizes[] = {sizeof(A), sizeof(B), sizeof(C), sizeof(D)};
+	return wb_soaBootstrap(info, sizes, 4, flags);
+}
+
+template<typename A, typename B, typename C, typename D, typename E>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags)
+{
+	wb_usize sizes[] = {sizeof(A), sizeof(B), sizeof(C), sizeof(D), sizeof(E)};
+	return wb_soaBootstrap(info, sizes, 5, flags);
+}
+
+template<typename A, typename B, typename C, typename D, typename E, typename F>
+WB_ALLOC_API
+wb_SoaPool* wb_soaBootstrap(wb_MemoryInfo info, wb_iflags flags)
+{
+	wb_usize sizes[] = {
+		sizeof(A), sizeof(B), sizeof(C), 
+		sizeof(D), sizeof(E), sizeof(F)
+	};
+	return wb_soaBootstrap(info, sizes, 6, flags);
+}
+
 template<typename T>
 WB_ALLOC_API 
 T* wb_taggedAlloc(wb_TaggedHeap* heap, wb_isize tag, int n)
 {
 	return reinterpret_cast<T*>(wb_taggedAlloc(heap, tag, sizeof(T) * n));
 }
+
+template<typename T>
+WB_ALLOC_API 
+T* wb_taggedAllocEx(wb_TaggedHeap* heap, wb_isize tag, 
+		WB_ALLOC_EXTENDED_INFO extended, int n)
+{
+	return reinterpret_cast<T*>(
+			wb_taggedAllocEx(heap, tag, sizeof(T) * n, 0, extended));
+}
+
+template<typename T>
+WB_ALLOC_API 
+T* wb_taggedThreadAlloc(wb_TaggedHeapThread* thread, wb_isize tag, int n)
+{
+	return reinterpret_cast<T*>(
+			wb_taggedThreadAlloc(thread, tag, sizeof(T) * n));
+}
+
+template<typename T>
+WB_ALLOC_API 
+T* wb_taggedPoolRetrieve(wb_TaggedPool* pool)
+{
+	return reinterpret_cast<T*>(wb_taggedPoolRetrieve(pool));
+}
 #endif
 #endif
 
@@ -0,0 +1,203 @@
+/* A couple of small benchmarks for the tagged heap. 
+ *
+ * The first is for the best-fit search: it fills one tag with a mix of 
+ * mostly small and occasionally large allocations, which leaves a lot of 
+ * room at the end of each arena when a big one doesn't fit, and reports 
+ * how many arenas each mode ended up using, and how long it took. The 
+ * linear mode is the search best fit used before the bins: walk the tag's
+ * chain until eight blocks fit, and take the tightest of those.
+ *
+ * The second is for size classes: it spreads a little bit of memory over 
+ * a lot of tags, and reports how much of the pool that took up.
+ *
+ * The third times how long tags take to grow back into freed blocks, 
+ * with and without taggedZeroBlocks zeroing them beforehand, and when the
+ * tags only used a little of each block.
+ */
+
+/* This is free and unencumbered software released into the public domain. */
+#include <stdio.h>
+#include <time.h>
+
+#define WB_ALLOC_IMPLEMENTATION
+#include "wb_alloc.h"
+
+#define BenchArenaSize (wb_CalcKilobytes(64))
+#define BenchAllocCount 200000
+#define BenchTagCount 500
+#define BenchBigArenaSize (wb_CalcMegabytes(2))
+#define BenchReuseCount 128
+
+static unsigned long benchSeed;
+static unsigned long benchRandom(void)
+{
+	benchSeed = benchSeed * 1103515245 + 12345;
+	return (benchSeed >> 16) & 0x7FFF;
+}
+
+static void* benchLinearAlloc(wb_TaggedHeap* heap, wb_isize tag, 
+		wb_usize size)
+{
+	wbi__TaggedHeapTag* entry;
+	wbi__TaggedHeapArena *arena, *canFit[wbi__TaggedHeapSearchSize];
+	wb_isize canFitCount;
+	void* oldHead;
+
+	entry = wbi__taggedFindTag(heap, tag, 1);
+	if(!entry->blocks) {
+		arena = wbi__taggedNextBlock(heap, entry, size);
+		wbi__taggedLinkBlock(heap, entry, arena);
+	}
+
+	arena = entry->blocks;
+	if((char*)arena->head + size > (char*)arena->end) {
+		canFitCount = 0;
+		while((arena = arena->next)) {
+			if((char*)arena->head + size <= (char*)arena->end) {
+				canFit[canFitCount++] = arena;
+				if(canFitCount == wbi__TaggedHeapSearchSize) break;
+			}
+		}
+		if(canFitCount > 0) {
+			wbi__taggedArenaSortBySize(canFit, canFitCount);
+			arena = canFit[0];
+		} else {
+			arena = wbi__taggedNextBlock(heap, entry, size);
+			wbi__taggedLinkBlock(heap, entry, arena);
+		}
+	}
+
+	oldHead = arena->head;
+	arena->head = (void*)wb_alignTo((wb_isize)arena->head + size, heap->align);
+	return oldHead;
+}
+
+static void runBench(const char* name, wb_MemoryInfo info, wb_iflags flags,
+		wb_isize linear)
+{
+	wb_TaggedHeap* heap;
+	wb_usize size, requested;
+	clock_t start;
+	double seconds;
+	wb_isize i, blocks;
+
+	heap = wb_taggedBootstrap(info, BenchArenaSize, flags);
+	benchSeed = 1;
+	requested = 0;
+
+	start = clock();
+	for(i = 0; i < BenchAllocCount; ++i) {
+		/* one in eight is somewhere up to half an arena, the rest are tiny */
+		if(benchRandom() % 8 == 0) {
+			size = benchRandom() % (BenchArenaSize / 2) + 1;
+		} else {
+			size = benchRandom() % 256 + 1;
+		}
+		requested += size;
+		if(linear) {
+			benchLinearAlloc(heap, 1, size);
+		} else {
+			wb_taggedAlloc(heap, 1, size);
+		}
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	blocks = (wb_isize)heap->tags[1].blockCount;
+	printf("  %-12s %6ld arenas, %7lukb used of %7lukb (%4.1f%%), %.3fs\n",
+			name, (long)blocks,
+			(unsigned long)(requested / 1024),
+			(unsigned long)(blocks * BenchArenaSize / 1024),
+			100.0 * (double)requested / (double)(blocks * BenchArenaSize),
+			seconds);
+	wb_taggedFree(heap, 1);
+}
+
+static void runTagsBench(const char* name, wb_MemoryInfo info, wb_iflags flags)
+{
+	wb_TaggedHeap* heap;
+	wb_usize requested, size;
+	clock_t start;
+	double seconds;
+	wb_isize i, j;
+
+	heap = wb_taggedBootstrap(info, BenchBigArenaSize, flags);
+	benchSeed = 1;
+	requested = 0;
+
+	start = clock();
+	for(i = 0; i < BenchTagCount; ++i) {
+		for(j = 0; j < 4; ++j) {
+			size = benchRandom() % 512 + 1;
+			requested += size;
+			wb_taggedAlloc(heap, 100 + i, size);
+		}
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("  %-12s %7lukb used, %9lukb of blocks, %.3fs\n",
+			name, 
+			(unsigned long)(requested / 1024),
+			(unsigned long)(heap->pool.count * heap->pool.elementSize / 1024),
+			seconds);
+	for(i = 0; i < BenchTagCount; ++i) {
+		wb_taggedFree(heap, 100 + i);
+	}
+}
+
+static void runReuseBench(const char* name, wb_MemoryInfo info, 
+		wb_usize size, wb_isize preZero)
+{
+	wb_TaggedHeap* heap;
+	clock_t start;
+	double seconds;
+	wb_isize i;
+
+	/* each tag gets a block of its own, and uses size bytes of it */
+	heap = wb_taggedBootstrap(info, BenchBigArenaSize, wb_TaggedHeap_Normal);
+	for(i = 0; i < BenchReuseCount; ++i) {
+		WB_ALLOC_MEMSET(wb_taggedAlloc(heap, 100 + i, size), 1, size);
+	}
+	for(i = 0; i < BenchReuseCount; ++i) {
+		wb_taggedFree(heap, 100 + i);
+	}
+	if(preZero) {
+		/* this would be on a worker thread, off the clock */
+		wb_taggedZeroBlocks(heap, BenchReuseCount);
+	}
+
+	start = clock();
+	for(i = 0; i < BenchReuseCount; ++i) {
+		wb_taggedAlloc(heap, 100 + i, size);
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	printf("  %-12s %.4fs\n", name, seconds);
+	for(i = 0; i < BenchReuseCount; ++i) {
+		wb_taggedFree(heap, 100 + i);
+	}
+}
+
+int main()
+{
+	wb_MemoryInfo info;
+	info = wb_getMemoryInfo();
+
+	printf("wb_alloc: tagged heap fragmentation benchmark\n");
+	printf("  %d allocations into one tag, %lukb arenas\n",
+			BenchAllocCount, (unsigned long)(BenchArenaSize / 1024));
+	runBench("first arena", info, wb_TaggedHeap_Normal, 0);
+	runBench("linear fit", info, wb_TaggedHeap_Normal, 1);
+	runBench("best fit", info, wb_TaggedHeap_SearchForBestFit, 0);
+
+	printf("  %d tags with a little in each, %lukb arenas\n",
+			BenchTagCount, (unsigned long)(BenchBigArenaSize / 1024));
+	runTagsBench("one size", info, wb_TaggedHeap_Normal);
+	runTagsBench("size classes", info, wb_TaggedHeap_SizeClasses);
+
+	printf("  %d freed %lukb blocks taken back by new tags\n",
+			BenchReuseCount, (unsigned long)(BenchBigArenaSize / 1024));
+	runReuseBench("all used", info, BenchBigArenaSize, 0);
+	runReuseBench("pre-zeroed", info, BenchBigArenaSize, 1);
+	runReuseBench("3kb used", info, wb_CalcKilobytes(3), 0);
+	return 0;
+}
@@ -0,0 +1,362 @@
+/* Replays an allocation trace recorded with WB_ALLOC_TRACE, against
+ * whatever configuration you give it, and reports how long that took, how
+ * many times memory was committed and decommitted, and the peak resident
+ * size. Run it a few times with different settings to compare them.
+ *
+ * To record a trace, define WB_ALLOC_TRACE, create the allocators you want
+ * to look at with wb_Arena_Trace, wb_Pool_Trace or wb_TaggedHeap_Trace,
+ * give each thread a wb_TraceRing with wb_traceAttach, and every so often
+ * write out what wb_traceRead gives you:
+ *
+ *	n = wb_traceRead(&ring, buffer, 4096);
+ *	fwrite(buffer, sizeof(wb_TraceRecord), n, file);
+ *
+ * Every thread's ring can go to the same file (or cat them together after);
+ * the replay puts the records back in order. The file is just
+ * wb_TraceRecords, so replay it on the same platform it was recorded on.
+ *
+ * Usage: wb_alloc_replay trace [-commit kb] [-arena kb]
+ *		[-pool flags] [-heap flags]
+ *
+ *	-commit kb	the commitSize for arenas and pools
+ *	-arena kb	the arenaSize for tagged heaps
+ *	-pool flags	the flags for every pool (eg. 64 for PoolGeometricGrowth)
+ *	-heap flags	the flags for every tagged heap (eg. 8 for best fit)
+ *
+ * Anything not given is replayed as it was recorded. Fixed-size allocators
+ * are replayed as growable ones, since the trace doesn't have their buffers.
+ */
+
+/* This is free and unencumbered software released into the public domain. */
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef WB_ALLOC_STATS
+#define WB_ALLOC_STATS
+#endif
+#define WB_ALLOC_IMPLEMENTATION
+#include "wb_alloc.h"
+
+typedef struct ReplayAllocator ReplayAllocator;
+struct ReplayAllocator
+{
+	wb_usize id;
+	wb_isize kind;
+	void* allocator;
+};
+
+typedef struct ReplayPointer ReplayPointer;
+struct ReplayPointer
+{
+	wb_usize from;
+	void* to;
+};
+
+static ReplayAllocator* allocators;
+static wb_isize allocatorCount, allocatorCapacity;
+
+/* Pool pointers in the trace are mapped to the replay's with an
+ * open-addressed table; 1 marks a removed entry */
+static ReplayPointer* pointers;
+static wb_usize pointerCapacity, pointerCount;
+
+static wb_usize optCommit, optArena;
+static wb_isize optPool = -1, optHeap = -1;
+
+static int compareRecords(const void* a, const void* b)
+{
+	wb_usize x, y;
+	x = ((const wb_TraceRecord*)a)->sequence;
+	y = ((const wb_TraceRecord*)b)->sequence;
+	return x < y ? -1 : x > y ? 1 : 0;
+}
+
+static wb_usize hashPointer(wb_usize p)
+{
+	p ^= p >> 17;
+	p *= 0x9E3779B9u;
+	return p ^ (p >> 13);
+}
+
+static void putPointer(wb_usize from, void* to);
+
+static void growPointers(void)
+{
+	ReplayPointer* old;
+	wb_usize oldCapacity, i;
+
+	old = pointers;
+	oldCapacity = pointerCapacity;
+	pointerCapacity = pointerCapacity ? pointerCapacity * 2 : 4096;
+	pointers = (ReplayPointer*)calloc(pointerCapacity, sizeof(ReplayPointer));
+	pointerCount = 0;
+	for(i = 0; i < oldCapacity; ++i) {
+		if(old[i].from > 1) {
+			putPointer(old[i].from, old[i].to);
+		}
+	}
+	free(old);
+}
+
+static void putPointer(wb_usize from, void* to)
+{
+	wb_usize i;
+	if((pointerCount + 1) * 2 > pointerCapacity) {
+		growPointers();
+	}
+	i = hashPointer(from) & (pointerCapacity - 1);
+	while(pointers[i].from > 1 && pointers[i].from != from) {
+		i = (i + 1) & (pointerCapacity - 1);
+	}
+	if(pointers[i].from <= 1) {
+		pointerCount++;
+	}
+	pointers[i].from = from;
+	pointers[i].to = to;
+}
+
+static void* takePointer(wb_usize from)
+{
+	wb_usize i;
+	if(!pointerCapacity) return NULL;
+	i = hashPointer(from) & (pointerCapacity - 1);
+	while(pointers[i].from) {
+		if(pointers[i].from == from) {
+			pointers[i].from = 1;
+			return pointers[i].to;
+		}
+		i = (i + 1) & (pointerCapacity - 1);
+	}
+	return NULL;
+}
+
+static wb_isize kindOf(wb_isize op)
+{
+	if(op <= wb_Trace_ArenaClear) return wb_Stats_Arena;
+	if(op <= wb_Trace_PoolRelease) return wb_Stats_Pool;
+	return wb_Stats_TaggedHeap;
+}
+
+static void* findAllocator(wb_TraceRecord* record)
+{
+	ReplayAllocator* a;
+	wb_MemoryInfo info;
+	wb_iflags flags;
+	wb_isize i, kind;
+
+	kind = kindOf(record->op);
+	for(i = allocatorCount - 1; i >= 0; --i) {
+		if(allocators[i].id == record->allocator &&
+				allocators[i].kind == kind) {
+			return allocators[i].allocator;
+		}
+	}
+
+	if(allocatorCount == allocatorCapacity) {
+		allocatorCapacity = allocatorCapacity ? allocatorCapacity * 2 : 16;
+		allocators = (ReplayAllocator*)realloc(allocators,
+				allocatorCapacity * sizeof(ReplayAllocator));
+	}
+	a = allocators + allocatorCount++;
+	a->id = record->allocator;
+	a->kind = kind;
+
+	info = wb_getMemoryInfo();
+	flags = (wb_iflags)record->flags;
+	switch(kind) {
+		case wb_Stats_Arena:
+			if(optCommit) info.commitSize = optCommit;
+			else if(record->param) info.commitSize = record->param;
+			a->allocator = wb_arenaBootstrap(info, flags & ~wb_Arena_FixedSize);
+			break;
+		case wb_Stats_Pool:
+			if(optCommit) info.commitSize = optCommit;
+			if(optPool >= 0) flags = optPool;
+			a->allocator = wb_poolBootstrap(info, (wb_isize)record->param,
+					flags & ~wb_Pool_FixedSize);
+			break;
+		default:
+			if(optHeap >= 0) flags = optHeap;
+			a->allocator = wb_taggedBootstrap(info,
+					optArena ? optArena : record->param,
+					flags & ~wb_TaggedHeap_FixedSize);
+			break;
+	}
+	return a->allocator;
+}
+
+static void replay(wb_TraceRecord* record)
+{
+	void* allocator;
+	void* ptr;
+
+	allocator = findAllocator(record);
+	switch(record->op) {
+		case wb_Trace_ArenaPush:
+			wb_arenaPush((wb_MemoryArena*)allocator, (wb_isize)record->value);
+			break;
+		case wb_Trace_ArenaPop:
+			wb_arenaPop((wb_MemoryArena*)allocator);
+			break;
+		case wb_Trace_ArenaStartTemp:
+			wb_arenaStartTemp((wb_MemoryArena*)allocator);
+			break;
+		case wb_Trace_ArenaEndTemp:
+			wb_arenaEndTemp((wb_MemoryArena*)allocator);
+			break;
+		case wb_Trace_ArenaClear:
+			wb_arenaClear((wb_MemoryArena*)allocator);
+			break;
+		case wb_Trace_PoolRetrieve:
+			ptr = wb_poolRetrieve((wb_MemoryPool*)allocator);
+			if(ptr) putPointer(record->value, ptr);
+			break;
+		case wb_Trace_PoolRelease:
+			ptr = takePointer(record->value);
+			if(ptr) wb_poolRelease((wb_MemoryPool*)allocator, ptr);
+			break;
+		case wb_Trace_TaggedAlloc:
+			wb_taggedAlloc((wb_TaggedHeap*)allocator, record->tag,
+					record->value);
+			break;
+		case wb_Trace_TaggedFree:
+			wb_taggedFree((wb_TaggedHeap*)allocator, record->tag);
+			break;
+		case wb_Trace_TaggedMerge:
+			wb_taggedMerge((wb_TaggedHeap*)allocator, record->tag,
+					(wb_isize)record->value);
+			break;
+	}
+}
+
+static unsigned long peakResidentKb(void)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+	return (unsigned long)(counters.PeakWorkingSetSize / 1024);
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return (unsigned long)(usage.ru_maxrss / 1024);
+#else
+	return (unsigned long)usage.ru_maxrss;
+#endif
+#endif
+}
+
+int main(int argc, char** argv)
+{
+	FILE* file;
+	wb_TraceRecord* records;
+	wb_AllocStats stats;
+	wb_usize commits, decommits, committed, highWater;
+	long size;
+	wb_isize count, i, missing, kinds[4];
+	unsigned long rssBefore;
+	const char* path;
+	clock_t start;
+	double seconds;
+
+	path = NULL;
+	for(i = 1; i < argc; ++i) {
+		if(argv[i][0] != '-') {
+			path = argv[i];
+		} else if(i + 1 < argc) {
+			if(!strcmp(argv[i], "-commit")) {
+				optCommit = wb_CalcKilobytes(strtol(argv[++i], NULL, 0));
+			} else if(!strcmp(argv[i], "-arena")) {
+				optArena = wb_CalcKilobytes(strtol(argv[++i], NULL, 0));
+			} else if(!strcmp(argv[i], "-pool")) {
+				optPool = strtol(argv[++i], NULL, 0);
+			} else if(!strcmp(argv[i], "-heap")) {
+				optHeap = strtol(argv[++i], NULL, 0);
+			} else {
+				path = NULL;
+				break;
+			}
+		} else {
+			path = NULL;
+			break;
+		}
+	}
+	if(!path) {
+		printf("usage: wb_alloc_replay trace [-commit kb] [-arena kb] "
+				"[-pool flags] [-heap flags]\n");
+		return 1;
+	}
+
+	file = fopen(path, "rb");
+	if(!file) {
+		printf("couldn't open %s\n", path);
+		return 1;
+	}
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	count = size / (long)sizeof(wb_TraceRecord);
+	records = (wb_TraceRecord*)malloc(count * sizeof(wb_TraceRecord) + 1);
+	count = (wb_isize)fread(records, sizeof(wb_TraceRecord), count, file);
+	fclose(file);
+
+	qsort(records, count, sizeof(wb_TraceRecord), compareRecords);
+	missing = 0;
+	for(i = 1; i < count; ++i) {
+		missing += records[i].sequence - records[i - 1].sequence - 1;
+	}
+
+	rssBefore = peakResidentKb();
+	start = clock();
+	for(i = 0; i < count; ++i) {
+		replay(records + i);
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	commits = decommits = committed = highWater = 0;
+	kinds[1] = kinds[2] = kinds[3] = 0;
+	for(i = 0; i < allocatorCount; ++i) {
+		switch(allocators[i].kind) {
+			case wb_Stats_Arena:
+				wb_arenaStats((wb_MemoryArena*)allocators[i].allocator, &stats);
+				break;
+			case wb_Stats_Pool:
+				wb_poolStats((wb_MemoryPool*)allocators[i].allocator, &stats);
+				break;
+			default:
+				wb_taggedStats((wb_TaggedHeap*)allocators[i].allocator, &stats);
+				break;
+		}
+		kinds[allocators[i].kind]++;
+		commits += stats.commits;
+		decommits += stats.decommits;
+		committed += stats.committed;
+		highWater += stats.highWater;
+	}
+
+	printf("wb_alloc: replayed %ld records from %s\n", (long)count, path);
+	if(missing) {
+		printf("  (%ld records were dropped while recording)\n", (long)missing);
+	}
+	printf("  %ld arenas, %ld pools, %ld tagged heaps\n",
+			(long)kinds[wb_Stats_Arena], (long)kinds[wb_Stats_Pool],
+			(long)kinds[wb_Stats_TaggedHeap]);
+	printf("  %.3fs\n", seconds);
+	printf("  %lu commits, %lu decommits\n",
+			(unsigned long)commits, (unsigned long)decommits);
+	printf("  %lukb committed at the end, %lukb high water\n",
+			(unsigned long)(committed / 1024),
+			(unsigned long)(highWater / 1024));
+	printf("  %lukb peak rss (%lukb before replaying)\n",
+			peakResidentKb(), rssBefore);
+	return 0;
+}
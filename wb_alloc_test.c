@@ -2,16 +2,1841 @@
  * wb_alloc works and how to do a simple initialization for them
  */
 
+/* After the demo, there are some checks for the rest of the library; they
+ * print FAILED and the line if something's wrong.
+ */
+
 /* This is free and unencumbered software released into the public domain. */
 #include <stdio.h>
 
+/* Counting errors lets the checks make sure the library catches misuse */
+static int testErrors;
+#define WB_ALLOC_ERROR_HANDLER(message, object, name) (testErrors++, \
+		fprintf(stderr, "wbAlloc error: [%s] %s\n", name, message))
+
 #define WB_ALLOC_IMPLEMENTATION
 #include "wb_alloc.h"
 
+#ifdef WB_ALLOC_POSIX
+#include <pthread.h>
+#endif
+
 #ifdef _MSC_VER
 /* Disable unused variable warnings on MSVC */
 #pragma warning(disable:189)
 #endif
+
+static int testFailures;
+static void testCheck(int ok, const char* what, int line)
+{
+	if(!ok) {
+		printf("  FAILED (line %d): %s\n", line, what);
+		testFailures++;
+	}
+}
+#define Check(x) testCheck((x) ? 1 : 0, #x, __LINE__)
+
+static void testPoolBatch(wb_MemoryInfo info)
+{
+	wb_MemoryPool* pool;
+	void* ptrs[64];
+	void* bad[3];
+	wb_isize i, j, n, errors;
+
+	printf("Pool batch test\n");
+	pool = wb_poolBootstrap(info, 24, wb_Pool_Normal);
+	n = wb_poolRetrieveBatch(pool, ptrs, 64);
+	Check(n == 64);
+	Check(pool->count == 64);
+	for(i = 0; i < n; ++i) {
+		Check(ptrs[i] != NULL && ((char*)ptrs[i])[23] == 0);
+		for(j = 0; j < i; ++j) {
+			Check(ptrs[i] != ptrs[j]);
+		}
+		WB_ALLOC_MEMSET(ptrs[i], 0xAB, 24);
+	}
+
+	wb_poolReleaseBatch(pool, ptrs + 32, 32);
+	Check(pool->count == 32);
+	Check(wb_poolRetrieve(pool) == ptrs[32]);
+	Check(((char*)ptrs[32])[23] == 0);
+	Check(wb_poolRetrieve(pool) == ptrs[33]);
+
+	/* the same pointer twice, and one that's already free */
+	errors = testErrors;
+	bad[0] = ptrs[0];
+	bad[1] = ptrs[1];
+	bad[2] = ptrs[0];
+	wb_poolReleaseBatch(pool, bad, 3);
+	Check(testErrors == errors + 1);
+	Check(pool->count == 34);
+	bad[2] = ptrs[40];
+	wb_poolReleaseBatch(pool, bad, 3);
+	Check(testErrors == errors + 2);
+	Check(pool->count == 34);
+
+	/* checking sorts the batch, so it goes on the list in address order */
+	for(i = 0; i < 16; ++i) {
+		ptrs[i] = ptrs[31 - i];
+	}
+	wb_poolReleaseBatch(pool, ptrs, 16);
+	Check(testErrors == errors + 2);
+	Check(pool->count == 18);
+	for(i = 1; i < 16; ++i) {
+		Check((char*)ptrs[i - 1] < (char*)ptrs[i]);
+	}
+	Check(wb_poolRetrieve(pool) == ptrs[0]);
+	wb_poolDestroy(pool);
+
+	pool = wb_poolBootstrap(info, 24, wb_Pool_TrackOccupancy);
+	n = wb_poolRetrieveBatch(pool, ptrs, 64);
+	errors = testErrors;
+	bad[0] = ptrs[5];
+	bad[1] = ptrs[6];
+	bad[2] = ptrs[5];
+	wb_poolReleaseBatch(pool, bad, 3);
+	Check(testErrors == errors + 1);
+	Check(pool->count == 64);
+	/* the bits cleared before the duplicate turned up have to be put back */
+	wb_poolReleaseBatch(pool, bad, 2);
+	Check(testErrors == errors + 1);
+	Check(pool->count == 62);
+	wb_poolDestroy(pool);
+}
+
+static void testPoolIter(wb_MemoryInfo info)
+{
+	wb_MemoryArena* arena;
+	wb_MemoryPool* pool;
+	wb_MemoryPool local;
+	wb_PoolIterator iter;
+	wb_usize* ptrs[200];
+	wb_usize* ptr;
+	wb_usize* last;
+	wb_isize i, n;
+
+	printf("Pool iterator test\n");
+	pool = wb_poolBootstrap(info, sizeof(wb_usize), wb_Pool_TrackOccupancy);
+	for(i = 0; i < 200; ++i) {
+		ptrs[i] = wb_poolRetrieve(pool);
+		*ptrs[i] = i;
+	}
+	for(i = 0; i < 200; i += 3) {
+		wb_poolRelease(pool, ptrs[i]);
+	}
+
+	n = 0;
+	last = NULL;
+	wb_poolIterBegin(pool, &iter);
+	while((ptr = wb_poolIterNext(&iter))) {
+		Check(*ptr % 3 != 0);
+		Check(ptr > last);
+		last = ptr;
+		n++;
+		/* releasing what we were just handed is fine */
+		if(*ptr % 3 == 1) wb_poolRelease(pool, ptr);
+	}
+	Check(n == 133);
+	Check(pool->count == 66);
+
+	n = 0;
+	wb_poolIterBegin(pool, &iter);
+	while((ptr = wb_poolIterNext(&iter))) {
+		Check(*ptr % 3 == 2);
+		n++;
+	}
+	Check(n == 66);
+	wb_poolDestroy(pool);
+
+	pool = wb_poolBootstrap(info, sizeof(wb_usize), wb_Pool_Compacting);
+	for(i = 0; i < 10; ++i) {
+		*(wb_usize*)wb_poolRetrieve(pool) = i;
+	}
+	wb_poolRelease(pool, pool->slots);
+	n = 0;
+	wb_poolIterBegin(pool, &iter);
+	while((ptr = wb_poolIterNext(&iter))) {
+		Check(*ptr != 0);
+		n++;
+	}
+	Check(n == 9);
+	wb_poolDestroy(pool);
+
+	/* poolDestroy leaves an arena it was handed alone */
+	arena = wb_arenaBootstrap(info, wb_Arena_Normal);
+	wb_poolInit(&local, arena, sizeof(wb_usize), wb_Pool_TrackOccupancy);
+	ptr = wb_poolRetrieve(&local);
+	*ptr = 1;
+	wb_poolDestroy(&local);
+	ptr = wb_arenaPush(arena, sizeof(wb_usize));
+	*ptr = 2;
+	Check(*ptr == 2);
+	wb_arenaDestroy(arena);
+}
+
+typedef struct TestHandles TestHandles;
+struct TestHandles
+{
+	wb_usize* ptrs[100];
+	wb_isize moves;
+};
+
+static void testRelocate(void* userdata, void* oldPtr, void* newPtr)
+{
+	TestHandles* handles = (TestHandles*)userdata;
+	wb_isize i;
+	handles->moves++;
+	for(i = 0; i < 100; ++i) {
+		if(handles->ptrs[i] == oldPtr) {
+			handles->ptrs[i] = (wb_usize*)newPtr;
+			return;
+		}
+	}
+	Check(!"relocated something we weren't holding");
+}
+
+static void testPoolDefragment(wb_MemoryInfo info)
+{
+	wb_MemoryPool* pool;
+	TestHandles handles;
+	wb_isize i, holes;
+
+	printf("Pool defragment test\n");
+	pool = wb_poolBootstrap(info, sizeof(wb_usize) * 4, 
+			wb_Pool_TrackOccupancy);
+	for(i = 0; i < 100; ++i) {
+		handles.ptrs[i] = wb_poolRetrieve(pool);
+		handles.ptrs[i][0] = i;
+	}
+	for(i = 0; i < 80; i += 2) {
+		wb_poolRelease(pool, handles.ptrs[i]);
+		handles.ptrs[i] = NULL;
+	}
+
+	/* a small budget leaves work for next time */
+	handles.moves = 0;
+	holes = wb_poolDefragment(pool, testRelocate, &handles, 5);
+	Check(handles.moves == 5);
+	Check(holes > 0);
+	while(holes > 0) {
+		holes = wb_poolDefragment(pool, testRelocate, &handles, 8);
+	}
+
+	Check(pool->count == 60);
+	Check(pool->lastFilled == 59);
+	for(i = 0; i < 100; ++i) {
+		if(!handles.ptrs[i]) continue;
+		Check(handles.ptrs[i][0] == (wb_usize)i);
+		Check(wb_poolIndex(pool, handles.ptrs[i]) < 60);
+	}
+
+	/* new elements go after the packed ones */
+	Check(wb_poolIndex(pool, wb_poolRetrieve(pool)) == 60);
+	wb_poolDestroy(pool);
+}
+
+static void testSoaPool(wb_MemoryInfo info)
+{
+	wb_SoaPool* soa;
+	wb_PoolIterator iter;
+	wb_usize fields[3];
+	float* xs;
+	double* ys;
+	wb_isize i, index, n;
+
+	printf("SoA pool test\n");
+	fields[0] = sizeof(float);
+	fields[1] = sizeof(double);
+	fields[2] = 1;
+	soa = wb_soaBootstrap(info, fields, 3, wb_Pool_TrackOccupancy);
+	for(i = 0; i < 5000; ++i) {
+		index = wb_soaRetrieve(soa);
+		Check(index == i);
+		*(float*)wb_soaField(soa, 0, index) = (float)i;
+		*(double*)wb_soaField(soa, 1, index) = i * 2.0;
+		*(char*)wb_soaField(soa, 2, index) = (char)(i & 0x7F);
+	}
+
+	/* the columns never move, and each one is just an array */
+	xs = (float*)wb_soaColumn(soa, 0);
+	ys = (double*)wb_soaColumn(soa, 1);
+	Check(xs[4999] == 4999.0f);
+	Check(ys[1234] == 2468.0);
+
+	for(i = 0; i < 5000; i += 2) {
+		wb_soaRelease(soa, i);
+	}
+	n = 0;
+	wb_soaIterBegin(soa, &iter);
+	while((index = wb_soaIterNext(&iter)) >= 0) {
+		Check(index % 2 == 1);
+		Check(xs[index] == (float)index);
+		n++;
+	}
+	Check(n == 2500);
+
+	index = wb_soaRetrieve(soa);
+	Check(index % 2 == 0 && index < 5000);
+	Check(xs[index] == 0.0f && ys[index] == 0.0);
+	Check(*(char*)wb_soaField(soa, 2, index) == 0);
+	wb_soaDestroy(soa);
+}
+
+static void testPoolTrim(wb_MemoryInfo info)
+{
+	wb_MemoryArena* arena;
+	wb_MemoryPool* pool;
+	wb_usize** ptrs;
+	wb_usize* ptr;
+	wb_isize i, perPage, count, released, ok;
+
+	printf("Pool trim test\n");
+	pool = wb_poolBootstrap(info, 64, wb_Pool_TrackOccupancy);
+	perPage = info.pageSize / 64;
+	count = perPage * 32;
+	arena = wb_arenaBootstrap(info, wb_Arena_Normal);
+	ptrs = wb_arenaPush(arena, sizeof(wb_usize*) * count);
+	for(i = 0; i < count; ++i) {
+		ptrs[i] = wb_poolRetrieve(pool);
+		ptrs[i][0] = i;
+	}
+
+	/* a hole in the middle gives back the whole pages inside it */
+	for(i = perPage * 4; i < perPage * 12; ++i) {
+		wb_poolRelease(pool, ptrs[i]);
+	}
+	released = wb_poolTrim(pool);
+	Check(released >= (wb_isize)info.pageSize * 7);
+	Check(pool->lastFilled == count - 1);
+
+	/* and freeing the end lowers lastFilled too */
+	for(i = perPage * 12; i < count; ++i) {
+		wb_poolRelease(pool, ptrs[i]);
+	}
+	released = wb_poolTrim(pool);
+	Check(released >= (wb_isize)info.pageSize * 19);
+	Check(pool->lastFilled == perPage * 4 - 1);
+
+	ok = 1;
+	for(i = 0; i < perPage * 4; ++i) {
+		if(ptrs[i][0] != (wb_usize)i) ok = 0;
+	}
+	Check(ok);
+
+	/* retrieve fills the lowest free slot again */
+	ptr = wb_poolRetrieve(pool);
+	Check(ptr == ptrs[perPage * 4]);
+	Check(ptr[0] == 0);
+	Check(wb_poolTrim(pool) >= 0);
+	wb_poolDestroy(pool);
+	wb_arenaDestroy(arena);
+}
+
+static void testPoolPageSlots(wb_MemoryInfo info)
+{
+	wb_MemoryPool* pool;
+	char* ptrs[4];
+	char* ptr;
+	wb_isize i, errors;
+
+	printf("Pool page slots test\n");
+	pool = wb_poolBootstrap(info, info.pageSize + 100, wb_Pool_PageSlots);
+	Check(pool->elementSize == info.pageSize * 2);
+	Check(pool->flags & wb_Pool_TrackOccupancy);
+	for(i = 0; i < 4; ++i) {
+		ptrs[i] = wb_poolRetrieve(pool);
+		Check((wb_usize)ptrs[i] % info.pageSize == 0);
+		WB_ALLOC_MEMSET(ptrs[i], 0x5A, pool->elementSize);
+	}
+
+	/* released slots come back as fresh pages, so they're zeroed */
+	wb_poolRelease(pool, ptrs[1]);
+	ptr = wb_poolRetrieve(pool);
+	Check(ptr == ptrs[1]);
+	Check(ptr[0] == 0 && ptr[pool->elementSize - 1] == 0);
+	Check(ptrs[2][0] == 0x5A);
+
+	errors = testErrors;
+	wb_poolRelease(pool, ptrs[3]);
+	wb_poolRelease(pool, ptrs[3]);
+	Check(testErrors == errors + 1);
+	Check(pool->count == 3);
+	wb_poolDestroy(pool);
+}
+
+static void testPoolGrowth(wb_MemoryInfo info)
+{
+	wb_MemoryArena* arena;
+	wb_MemoryPool* pool;
+	wb_isize i, capacity, ok;
+
+	printf("Pool growth test\n");
+	pool = wb_poolBootstrap(info, 64, wb_Pool_Normal);
+	pool->growCount = 1000;
+	while(pool->lastFilled < pool->capacity - 1) {
+		wb_poolRetrieve(pool);
+	}
+	capacity = pool->capacity;
+	wb_poolRetrieve(pool);
+	Check(pool->capacity >= capacity + 1000);
+	wb_poolDestroy(pool);
+
+	pool = wb_poolBootstrap(info, 64, wb_Pool_GeometricGrowth);
+	ok = 1;
+	for(i = 0; i < 5; ++i) {
+		while(pool->lastFilled < pool->capacity - 1) {
+			wb_poolRetrieve(pool);
+		}
+		capacity = pool->capacity;
+		wb_poolRetrieve(pool);
+		if(pool->capacity < capacity * 2) ok = 0;
+	}
+	Check(ok);
+	wb_poolDestroy(pool);
+
+	/* after a reserve, nothing commits until that many are used */
+	pool = wb_poolBootstrap(info, 64, wb_Pool_Normal);
+	Check(wb_poolReserve(pool, 10000, 1));
+	capacity = pool->capacity;
+	Check(capacity >= 10000);
+	for(i = 0; i < 10000; ++i) {
+		wb_poolRetrieve(pool);
+	}
+	Check(pool->capacity == capacity);
+	wb_poolDestroy(pool);
+
+	/* a fixed-size pool can't make room it doesn't have */
+	arena = wb_arenaBootstrap(info, wb_Arena_Normal);
+	pool = wb_poolFixedSizeBootstrap(64, wb_arenaPush(arena, 4096), 4096,
+			wb_Pool_Normal);
+	Check(!wb_poolReserve(pool, 1000, 0));
+	wb_arenaDestroy(arena);
+}
+
+static void testPoolSortFreeList(wb_MemoryInfo info)
+{
+	wb_MemoryPool* pool;
+	void* ptrs[100];
+	void *ptr, *last;
+	wb_isize i, pass, ok;
+
+	printf("Pool sort free list test\n");
+	for(pass = 0; pass < 2; ++pass) {
+		pool = wb_poolBootstrap(info, 16, 
+				pass ? wb_Pool_TrackOccupancy : wb_Pool_Normal);
+		for(i = 0; i < 100; ++i) {
+			ptrs[i] = wb_poolRetrieve(pool);
+		}
+		/* 37 and 100 share no factors, so this hits every slot once */
+		for(i = 0; i < 100; ++i) {
+			wb_poolRelease(pool, ptrs[i * 37 % 100]);
+		}
+		wb_poolSortFreeList(pool);
+
+		ok = 1;
+		last = NULL;
+		for(i = 0; i < 100; ++i) {
+			ptr = wb_poolRetrieve(pool);
+			if(ptr != ptrs[i] || ptr <= last) ok = 0;
+			last = ptr;
+		}
+		Check(ok);
+		Check(pool->count == 100 && pool->lastFilled == 99);
+		wb_poolDestroy(pool);
+	}
+}
+
+static void testPoolIndexLinks(wb_MemoryInfo info)
+{
+	wb_MemoryPool* pool;
+	char* ptrs[1000];
+	char* ptr;
+	wb_isize i, errors, ok;
+
+	printf("Pool index links test\n");
+	pool = wb_poolBootstrap(info, 6, wb_Pool_IndexLinks);
+	Check(pool->elementSize == 6);
+	for(i = 0; i < 1000; ++i) {
+		ptrs[i] = wb_poolRetrieve(pool);
+		WB_ALLOC_MEMSET(ptrs[i], (int)(i & 0x7F), 6);
+	}
+	Check(ptrs[999] - ptrs[0] == 999 * 6);
+	Check(wb_poolIndex(pool, ptrs[500]) == 500);
+	Check(wb_poolFromIndex(pool, 500) == ptrs[500]);
+
+	/* the links are unaligned, and writing them can't spill onto neighbours */
+	for(i = 1; i < 1000; i += 2) {
+		wb_poolRelease(pool, ptrs[i]);
+	}
+	ok = 1;
+	for(i = 0; i < 1000; i += 2) {
+		if(ptrs[i][0] != (char)(i & 0x7F) || ptrs[i][5] != (char)(i & 0x7F)) {
+			ok = 0;
+		}
+	}
+	Check(ok);
+	for(i = 999; i > 0; i -= 2) {
+		Check(wb_poolRetrieve(pool) == ptrs[i]);
+	}
+	Check(pool->count == 1000);
+
+	errors = testErrors;
+	wb_poolRelease(pool, ptrs[10]);
+	wb_poolRelease(pool, ptrs[10]);
+	Check(testErrors == errors + 1);
+	wb_poolDestroy(pool);
+
+	/* short links top out at 65535 elements */
+	pool = wb_poolBootstrap(info, 2, wb_Pool_ShortIndexLinks);
+	Check(pool->elementSize == 2);
+	ptr = NULL;
+	for(i = 0; i < 65535; ++i) {
+		ptr = wb_poolRetrieve(pool);
+	}
+	Check(ptr != NULL && wb_poolIndex(pool, ptr) == 65534);
+	wb_poolRelease(pool, ptr);
+	Check(wb_poolRetrieve(pool) == ptr);
+	errors = testErrors;
+	Check(wb_poolRetrieve(pool) == NULL);
+	Check(testErrors == errors + 1);
+	wb_poolDestroy(pool);
+}
+
+typedef struct TestTaggedWorker TestTaggedWorker;
+struct TestTaggedWorker
+{
+	wb_TaggedHeap* heap;
+	wb_isize tag, failures;
+};
+
+static void* testTaggedWork(void* userdata)
+{
+	TestTaggedWorker* worker = (TestTaggedWorker*)userdata;
+	wb_usize* ptrs[16];
+	wb_isize round, i, j;
+
+	for(round = 0; round < 200; ++round) {
+		for(i = 0; i < 16; ++i) {
+			ptrs[i] = wb_taggedAlloc(worker->heap, worker->tag, 
+					sizeof(wb_usize) * 40);
+			if(!ptrs[i]) {
+				worker->failures++;
+				return NULL;
+			}
+			for(j = 0; j < 40; ++j) {
+				if(ptrs[i][j]) worker->failures++;
+				ptrs[i][j] = (wb_usize)(worker->tag * 1000 + i);
+			}
+		}
+		for(i = 0; i < 16; ++i) {
+			for(j = 0; j < 40; ++j) {
+				if(ptrs[i][j] != (wb_usize)(worker->tag * 1000 + i)) {
+					worker->failures++;
+				}
+			}
+		}
+		wb_taggedFree(worker->heap, worker->tag);
+	}
+	return NULL;
+}
+
+static void testTaggedConcurrent(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	TestTaggedWorker workers[4];
+#ifdef WB_ALLOC_POSIX
+	pthread_t threads[4];
+#endif
+	wb_isize i;
+
+	printf("Tagged heap concurrency test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Concurrent);
+	for(i = 0; i < 4; ++i) {
+		workers[i].heap = heap;
+		workers[i].tag = i;
+		workers[i].failures = 0;
+	}
+#ifdef WB_ALLOC_POSIX
+	for(i = 0; i < 4; ++i) {
+		pthread_create(threads + i, NULL, testTaggedWork, workers + i);
+	}
+	for(i = 0; i < 4; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+#else
+	for(i = 0; i < 4; ++i) {
+		testTaggedWork(workers + i);
+	}
+#endif
+	for(i = 0; i < 4; ++i) {
+		Check(workers[i].failures == 0);
+	}
+	/* every block made it back onto the free stack */
+	Check((wb_isize)heap->hotBlockCount == heap->pool.count);
+	Check(heap->pool.count <= 16);
+	wb_arenaDestroy(heap->pool.alloc);
+
+	/* the same thing on a plain heap takes the non-atomic paths */
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Normal);
+	workers[0].heap = heap;
+	testTaggedWork(workers);
+	Check(workers[0].failures == 0);
+	Check((wb_isize)heap->hotBlockCount == heap->pool.count);
+	Check(heap->pool.count <= 4);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+static void testTaggedLarge(wb_MemoryInfo info)
+{
+	static wb_usize buffer[8192];
+	wb_TaggedHeap* heap;
+	char *small, *big, *other;
+	wb_isize i, errors, ok;
+
+	printf("Tagged heap large allocation test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Normal);
+	small = wb_taggedAlloc(heap, 3, 100);
+	big = wb_taggedAlloc(heap, 3, 5 * 4096 + 7);
+	Check(small != NULL && big != NULL);
+	Check(heap->tags[3].large != NULL && heap->tags[3].blockCount == 1);
+	ok = 1;
+	for(i = 0; i < 5 * 4096 + 7; ++i) {
+		if(big[i]) ok = 0;
+		big[i] = (char)i;
+	}
+	Check(ok);
+	/* big things don't use up blocks */
+	Check(heap->pool.count == 1);
+	other = wb_taggedAlloc(heap, 4, 9000);
+	Check(other != NULL && other != big);
+
+	wb_taggedFree(heap, 3);
+	Check(heap->tags[3].large == NULL && heap->tags[3].blocks == NULL);
+	Check(heap->tags[4].large != NULL);
+	big = wb_taggedAlloc(heap, 3, 5 * 4096 + 7);
+	Check(big != NULL && big[5 * 4096] == 0);
+	wb_taggedFree(heap, 3);
+	wb_taggedFree(heap, 4);
+	wb_arenaDestroy(heap->pool.alloc);
+
+	/* a fixed size heap can't map anything, so it still refuses */
+	heap = wb_taggedFixedSizeBootstrap(1024, buffer, sizeof(buffer), 
+			wb_TaggedHeap_Normal);
+	errors = testErrors;
+	Check(wb_taggedAlloc(heap, 0, 2048) == NULL);
+	Check(testErrors == errors + 1);
+	Check(wb_taggedAlloc(heap, 0, 100) != NULL);
+}
+
+static void testTaggedHashedTags(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	TestTaggedWorker workers[4];
+#ifdef WB_ALLOC_POSIX
+	pthread_t threads[4];
+#endif
+	wb_isize *a, *b, *c;
+	wb_isize i, ok;
+
+	printf("Tagged heap hashed tags test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Normal);
+	a = wb_taggedAlloc(heap, -5, sizeof(wb_isize));
+	b = wb_taggedAlloc(heap, (wb_isize)1 << 30, sizeof(wb_isize));
+	c = wb_taggedAlloc(heap, 0x7FFFFFFF, sizeof(wb_isize));
+	Check(a && b && c && a != b && b != c);
+	Check(heap->hashedCount == 3);
+	*a = 1;
+	*b = 2;
+	*c = 3;
+	wb_taggedFree(heap, (wb_isize)1 << 30);
+	Check(heap->hashedCount == 2);
+	Check(*a == 1 && *c == 3);
+	/* freeing a tag that isn't there is fine */
+	wb_taggedFree(heap, (wb_isize)1 << 30);
+	wb_taggedFree(heap, 123456);
+	Check(heap->hashedCount == 2);
+
+	/* lots of tags make the table grow */
+	ok = 1;
+	for(i = 0; i < 5000; ++i) {
+		a = wb_taggedAlloc(heap, 1000000 + i * 7, sizeof(wb_isize));
+		if(!a || *a) ok = 0;
+		else *a = i;
+	}
+	Check(ok);
+	Check(heap->hashedCount == 5002);
+	Check(heap->bucketCount >= 5002 / 2);
+	for(i = 0; i < 5000; ++i) {
+		wb_taggedFree(heap, 1000000 + i * 7);
+	}
+	wb_taggedFree(heap, -5);
+	wb_taggedFree(heap, 0x7FFFFFFF);
+	Check(heap->hashedCount == 0);
+	Check((wb_isize)heap->hotBlockCount == heap->pool.count);
+	wb_arenaDestroy(heap->pool.alloc);
+
+	/* and from a few threads at once */
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Concurrent);
+	for(i = 0; i < 4; ++i) {
+		workers[i].heap = heap;
+		workers[i].tag = 100000 + i;
+		workers[i].failures = 0;
+	}
+#ifdef WB_ALLOC_POSIX
+	for(i = 0; i < 4; ++i) {
+		pthread_create(threads + i, NULL, testTaggedWork, workers + i);
+	}
+	for(i = 0; i < 4; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+#else
+	for(i = 0; i < 4; ++i) {
+		testTaggedWork(workers + i);
+	}
+#endif
+	for(i = 0; i < 4; ++i) {
+		Check(workers[i].failures == 0);
+	}
+	Check(heap->hashedCount == 0);
+	Check((wb_isize)heap->hotBlockCount == heap->pool.count);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+typedef struct TestRetireWorker TestRetireWorker;
+struct TestRetireWorker
+{
+	wb_TaggedHeap* heap;
+	wb_isize first, failures;
+};
+
+static void* testRetireWork(void* userdata)
+{
+	TestRetireWorker* worker = (TestRetireWorker*)userdata;
+	wb_isize i;
+	for(i = 0; i < 200; ++i) {
+		if(!wb_taggedAlloc(worker->heap, worker->first + i, 64)) {
+			worker->failures++;
+		}
+		wb_taggedRetire(worker->heap, worker->first + i, NULL, 0);
+		if(worker->heap->retiredCount > WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT) {
+			worker->failures++;
+		}
+	}
+	return NULL;
+}
+
+static void testTaggedRetire(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	TestRetireWorker workers[4];
+#ifdef WB_ALLOC_POSIX
+	pthread_t threads[4];
+#endif
+	static wb_usize buffer[8192];
+	volatile wb_usize done;
+	wb_isize i, frameTag, lastTag, errors, ok;
+
+	printf("Tagged heap retire test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Normal);
+	done = 0;
+	Check(wb_taggedAlloc(heap, 5, 64) != NULL);
+	wb_taggedRetire(heap, 5, &done, 2);
+	Check(wb_taggedFrameCollect(heap) == 0);
+	Check(heap->tags[5].blocks != NULL);
+	done = 2;
+	Check(wb_taggedFrameCollect(heap) == 1);
+	Check(heap->tags[5].blocks == NULL);
+
+	/* a full ring waits on the oldest counter, then makes room */
+	done = 0;
+	for(i = 0; i < WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT; ++i) {
+		wb_taggedAlloc(heap, i, 64);
+		wb_taggedRetire(heap, i, &done, 1);
+	}
+	Check(heap->retiredCount == WB_ALLOC_TAGGEDHEAP_RETIRE_COUNT);
+	done = 1;
+	wb_taggedRetire(heap, 40, NULL, 0);
+	Check(heap->retiredCount == 1);
+	Check(wb_taggedFrameCollect(heap) == 1);
+
+	/* frames rotate tags, and free them as the counter catches up */
+	done = 0;
+	frameTag = wb_taggedFrameTag(heap);
+	Check(wb_taggedAlloc(heap, frameTag, 64) != NULL);
+	lastTag = frameTag;
+	frameTag = wb_taggedFrameAdvance(heap, &done, 1);
+	Check(frameTag != lastTag);
+	Check(wb_taggedAlloc(heap, frameTag, 64) != NULL);
+	Check(wbi__taggedFindTag(heap, lastTag, 0) != NULL);
+	done = 1;
+	frameTag = wb_taggedFrameAdvance(heap, &done, 2);
+	Check(wbi__taggedFindTag(heap, lastTag, 0)->blocks == NULL);
+	Check(heap->retiredCount == 1);
+	/* frame tags never need the hash table */
+	Check(heap->buckets == NULL);
+	wb_arenaDestroy(heap->pool.alloc);
+
+	/* so they work on a fixed size heap, with the GPU a couple of frames 
+	 * behind, for long after the ring of frame slots has wrapped */
+	heap = wb_taggedFixedSizeBootstrap(1024, buffer, sizeof(buffer), 
+			wb_TaggedHeap_Normal);
+	errors = testErrors;
+	done = 0;
+	ok = 1;
+	frameTag = wb_taggedFrameTag(heap);
+	lastTag = frameTag;
+	for(i = 1; i <= 5 * wbi__TaggedHeapFrameCount; ++i) {
+		if(!wb_taggedAlloc(heap, frameTag, 600)) ok = 0;
+		frameTag = wb_taggedFrameAdvance(heap, &done, (wb_usize)i);
+		if(i > 2) done = (wb_usize)i - 2;
+	}
+	Check(ok && testErrors == errors);
+	Check(heap->retiredCount <= 3);
+	/* a frame that's long gone doesn't get a slot back */
+	Check(wb_taggedAlloc(heap, lastTag, 16) == NULL);
+	Check(testErrors == errors + 1);
+	wb_taggedFree(heap, lastTag);
+	Check(wbi__taggedFindTag(heap, frameTag, 0)->tag == frameTag);
+
+	/* retiring from several threads can't overrun the ring */
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Concurrent);
+	for(i = 0; i < 4; ++i) {
+		workers[i].heap = heap;
+		workers[i].first = 1000 + i * 1000;
+		workers[i].failures = 0;
+	}
+#ifdef WB_ALLOC_POSIX
+	for(i = 0; i < 4; ++i) {
+		pthread_create(threads + i, NULL, testRetireWork, workers + i);
+	}
+	for(i = 0; i < 4; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+#else
+	for(i = 0; i < 4; ++i) {
+		testRetireWork(workers + i);
+	}
+#endif
+	for(i = 0; i < 4; ++i) {
+		Check(workers[i].failures == 0);
+	}
+	wb_taggedFrameCollect(heap);
+	Check(heap->retiredCount == 0);
+	Check(heap->hashedCount == 0);
+	Check((wb_isize)heap->hotBlockCount == heap->pool.count);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+static void testTaggedMerge(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	char *a, *b, *c;
+	wbi__TaggedHeapArena* block;
+	wb_isize i, errors, blocks, binned, ok;
+
+	printf("Tagged heap merge test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_SearchForBestFit);
+	a = wb_taggedAlloc(heap, 1, 100);
+	for(i = 0; i < 3; ++i) {
+		wb_taggedAlloc(heap, 2, 3000);
+	}
+	b = wb_taggedAlloc(heap, 2, 100);
+	c = wb_taggedAlloc(heap, 3, 5 * 4096);
+	a[0] = 1;
+	b[0] = 2;
+	c[0] = 3;
+	Check(heap->tags[2].blockCount == 3);
+
+	wb_taggedMerge(heap, 2, 1);
+	wb_taggedMerge(heap, 3, 1);
+	Check(heap->tags[2].blocks == NULL && heap->tags[3].large == NULL);
+	Check(heap->tags[1].blockCount == 4 && heap->tags[1].large != NULL);
+	Check(a[0] == 1 && b[0] == 2 && c[0] == 3);
+	/* into's current block stays current, and the merged leftovers get 
+	 * used before anything new is taken */
+	Check((char*)wb_taggedAlloc(heap, 1, 100) == a + 104);
+	Check(wb_taggedAlloc(heap, 1, 3700) != NULL);
+	blocks = heap->pool.count;
+	for(i = 0; i < 3; ++i) {
+		Check(wb_taggedAlloc(heap, 1, 900) != NULL);
+	}
+	Check(heap->pool.count == blocks);
+
+	/* when both have bins, from's are joined onto the ends of into's */
+	for(i = 0; i < 3; ++i) {
+		wb_taggedAlloc(heap, 6, 3000);
+		wb_taggedAlloc(heap, 7, 3000);
+	}
+	Check(heap->tags[6].bins != NULL && heap->tags[7].bins != NULL);
+	wb_taggedMerge(heap, 7, 6);
+	Check(heap->tags[7].bins == NULL && heap->tags[6].blockCount == 6);
+	binned = 0;
+	ok = 1;
+	for(i = 0; i < wbi__TaggedHeapBinCount; ++i) {
+		block = heap->tags[6].bins->heads[i];
+		if(!block != !(heap->tags[6].bins->mask & ((wb_usize)1 << i))) ok = 0;
+		for(; block; block = block->binNext) {
+			if(block == heap->tags[6].blocks) ok = 0;
+			if(!block->binNext && block != heap->tags[6].bins->tails[i]) ok = 0;
+			binned++;
+		}
+	}
+	Check(ok && binned == 5);
+	blocks = heap->pool.count;
+	for(i = 0; i < 5; ++i) {
+		Check(wb_taggedAlloc(heap, 6, 900) != NULL);
+	}
+	Check(heap->pool.count == blocks);
+	wb_taggedFree(heap, 6);
+
+	/* merging into a tag that doesn't exist yet just moves it */
+	wb_taggedMerge(heap, 1, 9);
+	Check(heap->tags[9].blockCount == 4 && heap->tags[1].blocks == NULL);
+	wb_taggedFree(heap, 9);
+	Check((wb_isize)heap->hotBlockCount == heap->pool.count);
+
+	/* tags in different modes stay put */
+	wb_taggedSetMode(heap, 4, wb_Arena_Stack);
+	wb_taggedAlloc(heap, 4, 16);
+	wb_taggedAlloc(heap, 5, 16);
+	errors = testErrors;
+	wb_taggedMerge(heap, 4, 5);
+	wb_taggedMerge(heap, 5, 4);
+	Check(testErrors == errors + 2);
+	Check(heap->tags[4].blocks != NULL && heap->tags[5].blocks != NULL);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+static void testTaggedTrim(wb_MemoryInfo info)
+{
+	static wb_usize buffer[8192];
+	wb_TaggedHeap* heap;
+	char* ptrs[8];
+	wb_isize i, j, ok;
+
+	printf("Tagged heap trim test\n");
+	heap = wb_taggedBootstrap(info, 65536, wb_TaggedHeap_Normal);
+	for(i = 0; i < 8; ++i) {
+		ptrs[i] = wb_taggedAlloc(heap, i, 60000);
+		WB_ALLOC_MEMSET(ptrs[i], 0xFF, 60000);
+	}
+	for(i = 0; i < 8; ++i) {
+		wb_taggedFree(heap, i);
+	}
+	Check(heap->hotBlockCount == 8);
+	Check(wb_taggedTrim(heap, 2) == 6);
+	Check(heap->hotBlockCount == 2);
+	Check(heap->coldBlocks != 0);
+	Check(wb_taggedTrim(heap, 2) == 0);
+
+	/* hot blocks come back first, and trimmed ones still come back zeroed */
+	ok = 1;
+	for(i = 0; i < 8; ++i) {
+		ptrs[i] = wb_taggedAlloc(heap, i, 60000);
+		for(j = 0; j < 60000; ++j) {
+			if(ptrs[i][j]) ok = 0;
+		}
+	}
+	Check(ok);
+	Check(heap->hotBlockCount == 0);
+	Check(heap->pool.count == 8);
+
+	/* with retainBlocks set, frees trim as they go */
+	heap->retainBlocks = 3;
+	for(i = 0; i < 8; ++i) {
+		wb_taggedFree(heap, i);
+		Check((wb_isize)heap->hotBlockCount <= 3);
+	}
+	Check(heap->hotBlockCount == 3);
+	Check(heap->pool.count == 8);
+	wb_arenaDestroy(heap->pool.alloc);
+
+	/* fixed size heaps have nowhere to give memory back to */
+	heap = wb_taggedFixedSizeBootstrap(1024, buffer, sizeof(buffer), 
+			wb_TaggedHeap_Normal);
+	wb_taggedAlloc(heap, 0, 100);
+	wb_taggedFree(heap, 0);
+	Check(wb_taggedTrim(heap, 0) == 0);
+	Check(heap->hotBlockCount == 1);
+}
+
+static void testTaggedBestFit(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	char *a, *b, *c, *d, *first;
+	wb_isize i;
+
+	printf("Tagged heap best fit test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_SearchForBestFit);
+	a = wb_taggedAlloc(heap, 1, 3000);
+	b = wb_taggedAlloc(heap, 1, 3500);
+	c = wb_taggedAlloc(heap, 1, 3900);
+	d = wb_taggedAlloc(heap, 1, 4000);
+	Check(heap->tags[1].blockCount == 4);
+
+	/* each one goes to the block with the least room that still fits */
+	Check((char*)wb_taggedAlloc(heap, 1, 500) == b + 3504);
+	Check((char*)wb_taggedAlloc(heap, 1, 150) == c + 3904);
+	Check((char*)wb_taggedAlloc(heap, 1, 1000) == a + 3000);
+	Check((char*)wb_taggedAlloc(heap, 1, 90) == d + 4000);
+	Check(heap->tags[1].blockCount == 4);
+	Check(wb_taggedAlloc(heap, 1, 200) != NULL);
+	Check(heap->tags[1].blockCount == 5);
+	wb_taggedFree(heap, 1);
+
+	/* the fit can be any distance down the chain */
+	first = wb_taggedAlloc(heap, 2, 3000);
+	for(i = 0; i < 20; ++i) {
+		wb_taggedAlloc(heap, 2, 4000);
+	}
+	Check((char*)wb_taggedAlloc(heap, 2, 1000) == first + 3000);
+	Check(heap->tags[2].blockCount == 21);
+
+	/* both blocks have room in the same bin, and the tighter one wins even
+	 * though the other was binned last */
+	a = wb_taggedAlloc(heap, 3, 3488);
+	b = wb_taggedAlloc(heap, 3, 3136);
+	wb_taggedAlloc(heap, 3, 4000);
+	Check(heap->tags[3].bins->heads[5] == heap->tags[3].blocks->next);
+	Check(heap->tags[3].bins->heads[5]->binNext == heap->tags[3].tail);
+	Check((char*)wb_taggedAlloc(heap, 3, 300) == a + 3488);
+	Check(heap->tags[3].blockCount == 3);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+static void testTaggedSizeClasses(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	char* ptr;
+	wb_isize i, j, ok;
+
+	printf("Tagged heap size classes test\n");
+	heap = wb_taggedBootstrap(info, 65536, wb_TaggedHeap_SizeClasses);
+	/* 64 small tags share one block */
+	for(i = 0; i < 64; ++i) {
+		ptr = wb_taggedAlloc(heap, 100 + i, 900);
+		WB_ALLOC_MEMSET(ptr, 0xFF, 900);
+	}
+	Check(heap->pool.count == 1);
+	Check(heap->classBlocks[WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 1] == NULL);
+	Check(wbi__taggedBlockClass(wbi__taggedFindTag(heap, 100, 0)->blocks) ==
+			WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 1);
+	/* bigger ones move up a size, or straight to a whole block */
+	wb_taggedAlloc(heap, 1, 900);
+	wb_taggedAlloc(heap, 1, 1000);
+	Check(wbi__taggedBlockClass(heap->tags[1].blocks) == 
+			WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 2);
+	wb_taggedAlloc(heap, 2, 60000);
+	Check(wbi__taggedBlockClass(heap->tags[2].blocks) == 0);
+	wb_taggedFree(heap, 1);
+	wb_taggedFree(heap, 2);
+
+	/* with one piece still out, the block stays carved (tag 1's two 
+	 * carved blocks are all free, so they're whole again) */
+	for(i = 1; i < 64; ++i) {
+		wb_taggedFree(heap, 100 + i);
+	}
+	Check(wb_taggedTrim(heap, 100) == 0);
+	Check(heap->hotBlockCount == 3);
+	Check(heap->classBlocks[WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 1] != NULL);
+	Check(heap->classBlocks[WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 2] == NULL);
+
+	/* once they're all back, they're whole again, and zeroed when reused */
+	wb_taggedFree(heap, 100);
+	wb_taggedTrim(heap, 100);
+	Check(heap->hotBlockCount == 4);
+	Check(heap->classBlocks[WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 1] == NULL);
+	ok = 1;
+	for(i = 0; i < 3; ++i) {
+		ptr = wb_taggedAlloc(heap, 10 + i, 65000);
+		for(j = 0; j < 65000; ++j) {
+			if(ptr[j]) ok = 0;
+		}
+	}
+	Check(ok);
+	Check(heap->pool.count == 4);
+	for(i = 0; i < 3; ++i) {
+		wb_taggedFree(heap, 10 + i);
+	}
+
+	/* with retainBlocks set, small tags' memory gets decommitted too */
+	heap->retainBlocks = 0;
+	wb_taggedTrim(heap, 0);
+	for(i = 0; i < 128; ++i) {
+		wb_taggedAlloc(heap, 100 + i, 900);
+	}
+	for(i = 0; i < 128; ++i) {
+		wb_taggedFree(heap, 100 + i);
+	}
+	Check(heap->hotBlockCount == 0);
+	Check(heap->classBlocks[WB_ALLOC_TAGGEDHEAP_CLASS_COUNT - 1] == NULL);
+	Check(heap->coldBlocks != 0);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+static void testTaggedModes(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	char *a, *b, *x;
+	wb_isize i, errors, ok;
+
+	printf("Tagged heap stack and temp test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Normal);
+
+	/* stack tags pop their newest allocation, zeroing it */
+	wb_taggedSetMode(heap, 3, wb_Arena_Stack);
+	a = wb_taggedAlloc(heap, 3, 100);
+	b = wb_taggedAlloc(heap, 3, 200);
+	WB_ALLOC_MEMSET(b, 0xFF, 200);
+	wb_taggedPop(heap, 3);
+	Check(b[0] == 0 && b[199] == 0);
+	Check(wb_taggedAlloc(heap, 3, 200) == b);
+	/* popping a block empty hands it back */
+	wb_taggedAlloc(heap, 3, 3900);
+	Check(heap->tags[3].blockCount == 2);
+	wb_taggedPop(heap, 3);
+	Check(heap->tags[3].blockCount == 1);
+	Check((char*)wb_taggedAlloc(heap, 3, 16) > b);
+	errors = testErrors;
+	wb_taggedAlloc(heap, 4, 16);
+	wb_taggedPop(heap, 4);
+	Check(testErrors == errors + 1);
+	wb_taggedFree(heap, 3);
+	wb_taggedFree(heap, 4);
+
+	/* temp scopes throw away everything since they started */
+	a = wb_taggedAlloc(heap, 5, 100);
+	wb_taggedStartTemp(heap, 5);
+	b = wb_taggedAlloc(heap, 5, 100);
+	WB_ALLOC_MEMSET(b, 0xFF, 100);
+	for(i = 0; i < 4; ++i) {
+		wb_taggedAlloc(heap, 5, 3000);
+	}
+	wb_taggedAlloc(heap, 5, 20000);
+	Check(heap->tags[5].blockCount == 4 && heap->tags[5].large != NULL);
+	wb_taggedEndTemp(heap, 5);
+	Check(heap->tags[5].blockCount == 1 && heap->tags[5].large == NULL);
+	Check(b[0] == 0 && b[99] == 0);
+	Check(wb_taggedAlloc(heap, 5, 100) == b);
+	wb_taggedFree(heap, 5);
+
+	/* a pop in a temp scope can go back past where it started */
+	wb_taggedSetMode(heap, 6, wb_Arena_Stack);
+	a = wb_taggedAlloc(heap, 6, 100);
+	x = wb_taggedAlloc(heap, 6, 100);
+	WB_ALLOC_MEMSET(x, 0xFF, 100);
+	wb_taggedStartTemp(heap, 6);
+	wb_taggedPop(heap, 6);
+	wb_taggedPop(heap, 6);
+	wb_taggedEndTemp(heap, 6);
+	Check(heap->tags[6].blocks != NULL);
+	Check(heap->tags[6].blocks->head == (void*)&heap->tags[6].blocks->buffer);
+	ok = 1;
+	for(i = 0; i < 100; ++i) {
+		if(x[i]) ok = 0;
+	}
+	Check(ok);
+	Check(wb_taggedAlloc(heap, 6, 100) == a);
+
+	/* and nothing can be merged into a stack tag or a temp scope */
+	wb_taggedSetMode(heap, 7, wb_Arena_Stack);
+	wb_taggedAlloc(heap, 7, 16);
+	wb_taggedAlloc(heap, 8, 16);
+	wb_taggedStartTemp(heap, 8);
+	wb_taggedAlloc(heap, 9, 16);
+	wb_taggedStartTemp(heap, 9);
+	errors = testErrors;
+	wb_taggedMerge(heap, 7, 6);
+	wb_taggedMerge(heap, 9, 8);
+	Check(testErrors == errors + 2);
+	Check(heap->tags[7].blocks != NULL && heap->tags[9].blocks != NULL);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+static volatile wb_isize testZeroStop;
+
+static void* testZeroWork(void* userdata)
+{
+	wb_TaggedHeap* heap = (wb_TaggedHeap*)userdata;
+	while(!testZeroStop) {
+		wb_taggedZeroBlocks(heap, 4);
+	}
+	return NULL;
+}
+
+static void testTaggedZeroBlocks(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	TestTaggedWorker workers[2];
+#ifdef WB_ALLOC_POSIX
+	pthread_t threads[2];
+#endif
+	char* ptrs[6];
+	wb_isize i, j, ok;
+
+	printf("Tagged heap zero blocks test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Normal);
+	for(i = 0; i < 6; ++i) {
+		ptrs[i] = wb_taggedAlloc(heap, i, 4000);
+		WB_ALLOC_MEMSET(ptrs[i], 0xFF, 4000);
+	}
+	for(i = 0; i < 6; ++i) {
+		wb_taggedFree(heap, i);
+	}
+	Check(wb_taggedZeroBlocks(heap, 2) == 2);
+	Check((heap->cleanBlocks & wbi__TaggedIndexMask) != 0);
+	Check(heap->hotBlockCount == 6);
+	/* zeroed blocks get handed out first, then the rest get zeroed inline */
+	ok = 1;
+	for(i = 0; i < 6; ++i) {
+		ptrs[i] = wb_taggedAlloc(heap, i, 4000);
+		for(j = 0; j < 4000; ++j) {
+			if(ptrs[i][j]) ok = 0;
+		}
+		WB_ALLOC_MEMSET(ptrs[i], 0xFF, 4000);
+		if(i == 1) {
+			Check((heap->cleanBlocks & wbi__TaggedIndexMask) == 0);
+		}
+	}
+	Check(ok);
+	Check(heap->pool.count == 6);
+	for(i = 0; i < 6; ++i) {
+		wb_taggedFree(heap, i);
+	}
+	Check(wb_taggedZeroBlocks(heap, 100) == 6);
+	Check(wb_taggedZeroBlocks(heap, 100) == 0);
+	wb_arenaDestroy(heap->pool.alloc);
+
+	/* with a worker zeroing in the background */
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Concurrent);
+	testZeroStop = 0;
+	workers[0].heap = heap;
+	workers[0].tag = 1;
+	workers[0].failures = 0;
+	workers[1] = workers[0];
+	workers[1].tag = 2;
+#ifdef WB_ALLOC_POSIX
+	pthread_create(threads, NULL, testZeroWork, heap);
+	pthread_create(threads + 1, NULL, testTaggedWork, workers + 1);
+	testTaggedWork(workers);
+	pthread_join(threads[1], NULL);
+	testZeroStop = 1;
+	pthread_join(threads[0], NULL);
+#else
+	testTaggedWork(workers);
+	wb_taggedZeroBlocks(heap, 100);
+	testTaggedWork(workers + 1);
+#endif
+	Check(workers[0].failures == 0 && workers[1].failures == 0);
+	Check((wb_isize)heap->hotBlockCount == heap->pool.count);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+static void testTaggedUsedSpan(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	wbi__TaggedHeapArena* block;
+	char* ptr;
+	wb_isize i, ok;
+
+	printf("Tagged heap used span test\n");
+	heap = wb_taggedBootstrap(info, 65536, wb_TaggedHeap_Normal);
+	ptr = wb_taggedAlloc(heap, 1, 3000);
+	WB_ALLOC_MEMSET(ptr, 0xFF, 3000);
+	block = heap->tags[1].blocks;
+	/* only what the tag used counts as dirty */
+	Check((char*)block->head == ptr + 3000);
+	Check(wbi__taggedDirtySize(block, heap->pool.elementSize) == 
+			(wb_usize)(ptr + 3000) - (wb_usize)block);
+	wb_taggedFree(heap, 1);
+	Check(block->head != NULL);
+
+	/* the span gets zeroed on the way back out, and past it never got 
+	 * dirty in the first place */
+	ptr = wb_taggedAlloc(heap, 2, 65000);
+	Check(heap->tags[2].blocks == block);
+	ok = 1;
+	for(i = 0; i < 65000; ++i) {
+		if(ptr[i]) ok = 0;
+	}
+	Check(ok);
+	wb_taggedFree(heap, 2);
+
+	/* a block that's never been used only has its header to clean */
+	block = (wbi__TaggedHeapArena*)wb_poolRetrieve(&heap->pool);
+	block->head = NULL;
+	Check(wbi__taggedDirtySize(block, heap->pool.elementSize) == 
+			sizeof(wbi__TaggedHeapArena));
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+static void testTaggedPool(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	wb_TaggedPool pool;
+	wb_usize *a, *b, *c;
+	wb_isize i, ok, errors;
+
+	printf("Tagged pool test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Normal);
+	wb_taggedPoolInit(&pool, heap, 1, 24);
+	a = wb_taggedPoolRetrieve(&pool);
+	b = wb_taggedPoolRetrieve(&pool);
+	Check(a && b && a != b && pool.count == 2);
+	a[0] = 1;
+	wb_taggedPoolRelease(&pool, a);
+	Check(pool.count == 1);
+	/* released slots come back first, zeroed */
+	c = wb_taggedPoolRetrieve(&pool);
+	Check(c == a && c[0] == 0);
+	ok = 1;
+	for(i = 0; i < 1000; ++i) {
+		if(!wb_taggedPoolRetrieve(&pool)) ok = 0;
+	}
+	Check(ok && pool.count == 1002);
+	Check(heap->tags[1].blockCount > 1);
+
+	/* freeing the tag empties the pool */
+	wb_taggedPoolRelease(&pool, b);
+	wb_taggedFree(heap, 1);
+	a = wb_taggedPoolRetrieve(&pool);
+	Check(a != b && pool.count == 1);
+	Check(pool.freeList == NULL);
+	wb_taggedFree(heap, 1);
+	/* releasing after the free is an error */
+	errors = testErrors;
+	wb_taggedPoolRelease(&pool, a);
+	Check(pool.freeList == NULL && testErrors == errors + 1);
+
+	/* a temp scope ending takes back the slots made in it */
+	wb_taggedPoolInit(&pool, heap, 2, 24);
+	a = wb_taggedPoolRetrieve(&pool);
+	wb_taggedStartTemp(heap, 2);
+	b = wb_taggedPoolRetrieve(&pool);
+	wb_taggedPoolRelease(&pool, b);
+	wb_taggedEndTemp(heap, 2);
+	c = wb_taggedPoolRetrieve(&pool);
+	Check(pool.count == 2 && c == b);
+	Check(wb_taggedPoolRetrieve(&pool) != c);
+
+	/* and so does a pop */
+	wb_taggedSetMode(heap, 3, wb_Arena_Stack);
+	wb_taggedPoolInit(&pool, heap, 3, 24);
+	a = wb_taggedPoolRetrieve(&pool);
+	b = wb_taggedPoolRetrieve(&pool);
+	wb_taggedPoolRelease(&pool, b);
+	wb_taggedPop(heap, 3);
+	c = wb_taggedAlloc(heap, 3, 64);
+	Check(c == b);
+	Check(wb_taggedPoolRetrieve(&pool) != b);
+
+	/* a pop that doesn't reach the pool's elements leaves them be */
+	wb_taggedPoolInit(&pool, heap, 4, 24);
+	wb_taggedSetMode(heap, 4, wb_Arena_Stack);
+	a = wb_taggedPoolRetrieve(&pool);
+	b = wb_taggedPoolRetrieve(&pool);
+	wb_taggedPoolRelease(&pool, a);
+	wb_taggedAlloc(heap, 4, 64);
+	wb_taggedPop(heap, 4);
+	errors = testErrors;
+	wb_taggedPoolRelease(&pool, b);
+	Check(testErrors == errors && pool.count == 0);
+	Check(wb_taggedPoolRetrieve(&pool) == b);
+	Check(wb_taggedPoolRetrieve(&pool) == a);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+typedef struct TestReader TestReader;
+struct TestReader
+{
+	wb_TaggedHeap* heap;
+	wb_usize* volatile* shared;
+	volatile wb_isize* stop;
+	wb_isize reads, failures;
+};
+
+static void* testReadWork(void* userdata)
+{
+	TestReader* reader = (TestReader*)userdata;
+	wb_usize* data;
+	wb_isize slot, i;
+
+	slot = wb_taggedReaderRegister(reader->heap);
+	if(slot < 0) {
+		reader->failures++;
+		return NULL;
+	}
+	while(!*reader->stop) {
+		wb_taggedReadBegin(reader->heap, slot);
+		data = *reader->shared;
+		for(i = 0; i < 64; ++i) {
+			if(!data[i] || data[i] != data[0]) reader->failures++;
+		}
+		wb_taggedReadEnd(reader->heap, slot);
+		reader->reads++;
+	}
+	wb_taggedReaderUnregister(reader->heap, slot);
+	return NULL;
+}
+
+static void testTaggedDeferred(wb_MemoryInfo info)
+{
+	wb_TaggedHeap* heap;
+	TestReader readers[3];
+#ifdef WB_ALLOC_POSIX
+	pthread_t threads[3];
+#endif
+	wb_usize* volatile shared;
+	volatile wb_isize stop;
+	wb_usize* data;
+	wb_isize i, j, slot, slots[WB_ALLOC_TAGGEDHEAP_READER_COUNT], errors;
+
+	printf("Tagged heap deferred free test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Concurrent);
+	slot = wb_taggedReaderRegister(heap);
+	Check(slot == 0);
+
+	/* a reader that's in the middle of a read holds the memory up */
+	wb_taggedReadBegin(heap, slot);
+	wb_taggedAlloc(heap, 1, 64);
+	wb_taggedFreeDeferred(heap, 1);
+	Check(heap->tags[1].blocks == NULL);
+	Check(heap->hotBlockCount == 0);
+	Check(wb_taggedReclaim(heap) == 0);
+	wb_taggedReadEnd(heap, slot);
+	Check(wb_taggedReclaim(heap) == 1);
+	Check(heap->hotBlockCount == 1);
+
+	/* but one that started after the free doesn't */
+	wb_taggedAlloc(heap, 2, 64);
+	wb_taggedFreeDeferred(heap, 2);
+	Check(heap->limbo == NULL);
+	wb_taggedReadBegin(heap, slot);
+	wb_taggedAlloc(heap, 3, 64);
+	wb_taggedFreeDeferred(heap, 3);
+	Check(heap->limbo != NULL);
+
+	/* unregistering lets go of whatever the reader was holding */
+	wb_taggedReaderUnregister(heap, slot);
+	Check(heap->limbo == NULL);
+
+	/* slots get reused */
+	for(i = 0; i < WB_ALLOC_TAGGEDHEAP_READER_COUNT; ++i) {
+		slots[i] = wb_taggedReaderRegister(heap);
+	}
+	Check(slots[0] == 0);
+	Check(slots[WB_ALLOC_TAGGEDHEAP_READER_COUNT - 1] ==
+			WB_ALLOC_TAGGEDHEAP_READER_COUNT - 1);
+	errors = testErrors;
+	Check(wb_taggedReaderRegister(heap) == -1);
+	Check(testErrors == errors + 1);
+	wb_taggedReaderUnregister(heap, 5);
+	Check(wb_taggedReaderRegister(heap) == 5);
+	for(i = 0; i < WB_ALLOC_TAGGEDHEAP_READER_COUNT; ++i) {
+		wb_taggedReaderUnregister(heap, slots[i]);
+	}
+	Check(heap->readers[5].used == 0);
+
+	/* readers never see freed memory while an owner swaps the data out */
+	stop = 0;
+	data = wb_taggedAlloc(heap, 10, sizeof(wb_usize) * 64);
+	for(j = 0; j < 64; ++j) {
+		data[j] = 1;
+	}
+	shared = data;
+	for(i = 0; i < 3; ++i) {
+		readers[i].heap = heap;
+		readers[i].shared = &shared;
+		readers[i].stop = &stop;
+		readers[i].reads = 0;
+		readers[i].failures = 0;
+	}
+#ifdef WB_ALLOC_POSIX
+	for(i = 0; i < 3; ++i) {
+		pthread_create(threads + i, NULL, testReadWork, readers + i);
+	}
+#endif
+	for(i = 1; i < 2000; ++i) {
+		data = wb_taggedAlloc(heap, 10 + i % 8, sizeof(wb_usize) * 64);
+		for(j = 0; j < 64; ++j) {
+			data[j] = (wb_usize)i + 1;
+		}
+		shared = data;
+		wb_taggedFreeDeferred(heap, 10 + (i - 1) % 8);
+	}
+	stop = 1;
+#ifdef WB_ALLOC_POSIX
+	for(i = 0; i < 3; ++i) {
+		pthread_join(threads[i], NULL);
+	}
+#else
+	for(i = 0; i < 3; ++i) {
+		testReadWork(readers + i);
+	}
+#endif
+	for(i = 0; i < 3; ++i) {
+		Check(readers[i].failures == 0);
+	}
+	wb_taggedReclaim(heap);
+	Check(heap->limbo == NULL);
+	wb_arenaDestroy(heap->pool.alloc);
+}
+
+typedef struct TestNode TestNode;
+struct TestNode
+{
+	TestNode* next;
+	wb_usize value;
+};
+
+static void testTaggedEvacuate(wb_MemoryInfo info)
+{
+	static wb_usize buffer[8192];
+	static const wb_usize nextOffset[1] = {0};
+	wb_TaggedHeap* heap;
+	wb_TaggedObject objects[20];
+	TestNode *nodes[20], *node, *first;
+	wb_isize i, n, errors, ok;
+	void *kept, *keptHead, *other;
+	char* big;
+
+	printf("Tagged heap evacuate test\n");
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Normal);
+
+	/* a list spread out between a lot of garbage, linked backwards */
+	for(i = 0; i < 20; ++i) {
+		nodes[i] = wb_taggedAlloc(heap, 1, sizeof(TestNode));
+		nodes[i]->value = i + 1;
+		wb_taggedAlloc(heap, 1, 500);
+	}
+	for(i = 0; i < 20; ++i) {
+		nodes[i]->next = i ? nodes[i - 1] : NULL;
+		objects[i].ptr = nodes[i];
+		objects[i].size = sizeof(TestNode);
+		objects[i].align = 0;
+		objects[i].pointers = nextOffset;
+		objects[i].pointerCount = 1;
+	}
+	Check(heap->tags[1].blockCount > 2);
+	other = &n;
+	first = nodes[19];
+	Check(wb_taggedEvacuate(heap, 1, 2, objects, 20) == 20);
+	Check(heap->tags[1].blocks == NULL);
+	Check(heap->tags[2].blockCount == 1);
+	Check(wb_taggedForward(objects, 20, other) == other);
+	Check(wb_taggedForward(objects, 20, &first->value) != &first->value);
+	first = wb_taggedForward(objects, 20, first);
+	ok = 1;
+	n = 0;
+	for(node = first; node; node = node->next) {
+		if(node->value != (wb_usize)(20 - n)) ok = 0;
+		n++;
+	}
+	Check(ok && n == 20);
+	/* the array comes back sorted, and neighbours stay neighbours */
+	for(i = 1; i < 20; ++i) {
+		if((char*)objects[i].ptr <= (char*)objects[i - 1].ptr) ok = 0;
+		if((char*)objects[i].moved <= (char*)objects[i - 1].moved) ok = 0;
+	}
+	Check(ok);
+	wb_taggedFree(heap, 2);
+
+	/* extended info goes along, but only into an extended tag */
+	wb_taggedSetMode(heap, 5, wb_Arena_Extended);
+	objects[0].ptr = wb_taggedAllocEx(heap, 5, 40, 0, 77);
+	objects[0].size = 40;
+	objects[0].align = 64;
+	objects[0].pointerCount = 0;
+	errors = testErrors;
+	Check(wb_taggedEvacuate(heap, 5, 6, objects, 1) == -1);
+	Check(testErrors == errors + 1);
+	Check(heap->tags[5].blocks != NULL && heap->tags[6].blocks == NULL);
+	wb_taggedSetMode(heap, 6, wb_Arena_Extended);
+	Check(wb_taggedEvacuate(heap, 5, 6, objects, 1) == 1);
+	Check(((WB_ALLOC_EXTENDED_INFO*)objects[0].moved)[-1] == 77);
+	Check(((wb_usize)objects[0].moved & 63) == 0);
+	wb_taggedFree(heap, 6);
+
+	/* from has to exist, and every object has to be inside it, before 
+	 * anything is copied */
+	errors = testErrors;
+	Check(wb_taggedEvacuate(heap, 7, 9, objects, 1) == -1);
+	objects[0].ptr = wb_taggedAlloc(heap, 7, 40);
+	objects[0].size = 40;
+	objects[0].align = 0;
+	objects[1].ptr = wb_taggedAlloc(heap, 8, 40);
+	objects[1].size = 40;
+	objects[1].align = 0;
+	objects[1].pointerCount = 0;
+	Check(wb_taggedEvacuate(heap, 7, 9, objects, 2) == -1);
+	big = wb_taggedAlloc(heap, 7, 10000);
+	objects[1].ptr = big - 8;
+	objects[1].size = 8;
+	Check(wb_taggedEvacuate(heap, 7, 9, objects, 2) == -1);
+	Check(testErrors == errors + 3);
+	Check(heap->tags[9].blocks == NULL && heap->tags[9].large == NULL);
+	objects[0].ptr = big;
+	objects[0].size = 10000;
+	objects[1].ptr = wb_taggedAlloc(heap, 7, 40);
+	objects[1].size = 40;
+	Check(wb_taggedEvacuate(heap, 7, 9, objects, 2) == 2);
+	Check(heap->tags[9].blocks != NULL && heap->tags[9].large != NULL);
+	wb_arenaDestroy(heap->pool.alloc);
+
+	/* concurrent heaps can only align to the heap's alignment */
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Concurrent);
+	objects[0].ptr = wb_taggedAlloc(heap, 1, 40);
+	objects[0].size = 40;
+	objects[0].align = 64;
+	errors = testErrors;
+	Check(wb_taggedEvacuate(heap, 1, 2, objects, 1) == -1);
+	Check(testErrors == errors + 1);
+	objects[0].align = 0;
+	Check(wb_taggedEvacuate(heap, 1, 2, objects, 1) == 1);
+	Check(heap->tags[1].blocks == NULL && heap->tags[2].blocks != NULL);
+	wb_arenaDestroy(heap->pool.alloc);
+
+	/* running out partway takes the copies back out, and leaves into's 
+	 * temp scope as it was */
+	heap = wb_taggedFixedSizeBootstrap(1024, buffer, sizeof(buffer), 
+			wb_TaggedHeap_Normal);
+	for(i = 0; i < 8; ++i) {
+		objects[i].ptr = wb_taggedAlloc(heap, 1, 400);
+		objects[i].size = 400;
+		objects[i].align = 0;
+		objects[i].pointerCount = 0;
+		WB_ALLOC_MEMSET(objects[i].ptr, (int)i + 1, 400);
+	}
+	kept = wb_taggedAlloc(heap, 2, 16);
+	wb_taggedStartTemp(heap, 2);
+	keptHead = heap->tags[2].blocks->head;
+
+	errors = testErrors;
+	n = 0;
+	while(wb_taggedAlloc(heap, 3, 1000)) n++;
+	wb_taggedFree(heap, 3);
+	for(i = 0; i < n - 2; ++i) {
+		wb_taggedAlloc(heap, 3, 1000);
+	}
+	Check(wb_taggedEvacuate(heap, 1, 2, objects, 8) == -1);
+	Check(testErrors > errors);
+	ok = 1;
+	for(i = 0; i < 8; ++i) {
+		if(objects[i].moved) ok = 0;
+		big = (char*)objects[i].ptr;
+		if(big[0] != (char)(i + 1) || big[399] != (char)(i + 1)) ok = 0;
+	}
+	Check(ok);
+	Check(heap->tags[1].blockCount == 4);
+	Check(heap->tags[2].blockCount == 1);
+	Check(heap->tags[2].blocks->head == keptHead);
+	Check(heap->tags[2].flags & wbi__TaggedTagTemp);
+	Check(heap->tags[2].tempHead == keptHead);
+	/* the blocks it took came back */
+	Check(wb_taggedAlloc(heap, 4, 1000) != NULL);
+	Check(wb_taggedAlloc(heap, 4, 1000) != NULL);
+	wb_taggedEndTemp(heap, 2);
+	Check(heap->tags[2].blocks->head == keptHead);
+	Check(wb_taggedAlloc(heap, 2, 16) == (char*)kept + 16);
+}
+
+static void testStats(wb_MemoryInfo info)
+{
+	wb_MemoryArena* arena;
+	wb_MemoryPool* pool;
+	wb_TaggedHeap* heap;
+	wb_AllocStats stats, before, collected[4];
+	wbi__TaggedHeapArena* block;
+	void* a;
+	wb_usize dirty, zeroed;
+	wb_isize i, n, found;
+
+	printf("Stats test\n");
+	arena = wb_arenaBootstrap(info, wb_Arena_Normal);
+	arena->name = "statsArena";
+	wb_arenaStats(arena, &before);
+	wb_arenaPush(arena, 128);
+	wb_arenaStats(arena, &stats);
+	Check(stats.kind == wb_Stats_Arena);
+	Check(stats.used - before.used == 128);
+	Check(stats.highWater >= stats.used && stats.committed >= stats.used);
+#ifdef WB_ALLOC_STATS
+	Check(stats.allocs - before.allocs == 1);
+	Check(stats.bytes - before.bytes == 128);
+#endif
+
+	pool = wb_poolBootstrap(info, 32, wb_Pool_Normal);
+	a = wb_poolRetrieve(pool);
+	wb_poolRetrieve(pool);
+	wb_poolRetrieve(pool);
+	wb_poolRelease(pool, a);
+	wb_poolStats(pool, &stats);
+	Check(stats.kind == wb_Stats_Pool);
+	Check(stats.used == 2 * pool->elementSize);
+	Check(stats.freeListLength == 1);
+#ifdef WB_ALLOC_STATS
+	Check(stats.allocs == 3 && stats.frees == 1);
+#endif
+
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Normal);
+	heap->name = "statsHeap";
+	wb_taggedAlloc(heap, 1, 1000);
+	wb_taggedTagStats(heap, 1, &stats);
+	Check(stats.used == 1000 && stats.blockCount == 1 && stats.tagCount == 1);
+	block = heap->tags[1].blocks;
+	dirty = (wb_usize)block->head - (wb_usize)block;
+	wb_taggedFree(heap, 1);
+	wb_taggedStats(heap, &stats);
+	Check(stats.freeListLength == 1 && stats.tagCount == 0);
+	zeroed = stats.zeroedBytes;
+
+	/* reusing a freed block zeroes just as much as it dirtied */
+	wb_taggedAlloc(heap, 2, 16);
+	wb_taggedStats(heap, &stats);
+	Check(stats.tagCount == 1);
+#ifdef WB_ALLOC_STATS
+	Check(stats.zeroedBytes - zeroed == dirty);
+	Check(stats.allocs == 2 && stats.frees == 1);
+#else
+	/* without WB_ALLOC_STATS the counters just stay at zero */
+	Check(stats.zeroedBytes == zeroed && dirty > 1000);
+#endif
+
+	/* and so does zeroing it ahead of time */
+	wb_taggedAlloc(heap, 3, 1000);
+	block = heap->tags[3].blocks;
+	dirty = (wb_usize)block->head - (wb_usize)block;
+	wb_taggedFree(heap, 3);
+	zeroed = stats.zeroedBytes;
+	Check(wb_taggedZeroBlocks(heap, 4) == 1);
+	wb_taggedStats(heap, &stats);
+#ifdef WB_ALLOC_STATS
+	Check(stats.zeroedBytes - zeroed == dirty);
+#else
+	Check(stats.zeroedBytes == zeroed && dirty > 1000);
+#endif
+
+	Check(wb_statsRegister(arena, wb_Stats_Arena));
+	Check(wb_statsRegister(heap, wb_Stats_TaggedHeap));
+	n = wb_statsCollect(collected, 4);
+	Check(n == 2);
+	found = 0;
+	for(i = 0; i < n; ++i) {
+		if(collected[i].name == arena->name && 
+				collected[i].kind == wb_Stats_Arena) found++;
+		if(collected[i].name == heap->name && 
+				collected[i].kind == wb_Stats_TaggedHeap) found++;
+	}
+	Check(found == 2);
+	wb_statsUnregister(arena);
+	wb_statsUnregister(heap);
+	Check(wb_statsCollect(collected, 4) == 0);
+
+	wb_arenaDestroy(heap->pool.alloc);
+	wb_arenaDestroy(pool->alloc);
+	wb_arenaDestroy(arena);
+}
+
+#ifdef WB_ALLOC_TRACE
+static void testTrace(wb_MemoryInfo info)
+{
+	wb_MemoryArena* arena;
+	wb_MemoryPool* pool;
+	wb_TaggedHeap* heap;
+	wb_TraceRing ring;
+	wb_TraceRecord records[8], out[16], back[16];
+	void* ptr;
+	wb_isize i, n, errors, ok;
+	FILE* file;
+
+	printf("Trace test\n");
+	arena = wb_arenaBootstrap(info, wb_Arena_Trace);
+	pool = wb_poolBootstrap(info, 32, wb_Pool_Trace);
+	heap = wb_taggedBootstrap(info, 4096, wb_TaggedHeap_Trace);
+
+	/* nothing's recorded until the thread has a ring */
+	wb_traceRingInit(&ring, records, 8);
+	wb_arenaPush(arena, 16);
+	Check(ring.head == 0);
+
+	wb_traceAttach(&ring);
+	Check(ring.thread != 0);
+	wb_arenaPush(arena, 24);
+	ptr = wb_poolRetrieve(pool);
+	wb_poolRelease(pool, ptr);
+	wb_taggedAlloc(heap, 3, 100);
+	wb_taggedMerge(heap, 3, 4);
+	wb_taggedFree(heap, 4);
+	n = wb_traceRead(&ring, out, 16);
+	Check(n == 6);
+	Check(out[0].op == wb_Trace_ArenaPush && out[0].value == 24);
+	Check(out[0].allocator == (wb_usize)arena);
+	Check(out[0].param == arena->info.commitSize);
+	Check(out[1].op == wb_Trace_PoolRetrieve && out[1].value == (wb_usize)ptr);
+	Check(out[1].param == pool->elementSize);
+	Check(out[2].op == wb_Trace_PoolRelease && out[2].value == (wb_usize)ptr);
+	Check(out[3].op == wb_Trace_TaggedAlloc && out[3].tag == 3);
+	Check(out[3].value == 100 && out[3].param == heap->arenaSize);
+	Check(out[4].op == wb_Trace_TaggedMerge && out[4].tag == 3);
+	Check(out[4].value == 4);
+	Check(out[5].op == wb_Trace_TaggedFree && out[5].tag == 4);
+	ok = 1;
+	for(i = 0; i < n; ++i) {
+		if(out[i].thread != ring.thread) ok = 0;
+		if(i && out[i].sequence <= out[i - 1].sequence) ok = 0;
+	}
+	Check(ok);
+	Check(wb_traceRead(&ring, out, 16) == 0);
+
+	/* the records survive a trip through a file, which is how the replay 
+	 * tool gets them */
+	file = tmpfile();
+	Check(file != NULL);
+	if(file) {
+		Check(fwrite(out, sizeof(wb_TraceRecord), n, file) == (size_t)n);
+		rewind(file);
+		Check(fread(back, sizeof(wb_TraceRecord), 16, file) == (size_t)n);
+		ok = 1;
+		for(i = 0; i < n; ++i) {
+			if(back[i].sequence != out[i].sequence || 
+					back[i].allocator != out[i].allocator ||
+					back[i].value != out[i].value || 
+					back[i].tag != out[i].tag || back[i].op != out[i].op) {
+				ok = 0;
+			}
+		}
+		Check(ok);
+		fclose(file);
+	}
+
+	/* a full ring drops records, but still uses up their sequence numbers */
+	for(i = 0; i < 10; ++i) {
+		wb_arenaPush(arena, 8);
+	}
+	Check(ring.dropped == 2);
+	n = wb_traceRead(&ring, out, 16);
+	Check(n == 8);
+	Check(out[0].sequence - back[5].sequence == 1);
+	Check(out[7].sequence - out[0].sequence == 7);
+	wb_arenaPush(arena, 8);
+	Check(wb_traceRead(&ring, out, 16) == 1);
+	Check(out[0].sequence - back[5].sequence == 11);
+
+	wb_traceAttach(NULL);
+	wb_arenaPush(arena, 8);
+	Check(ring.head == ring.tail);
+
+	errors = testErrors;
+	wb_traceRingInit(&ring, records, 6);
+	Check(testErrors == errors + 1);
+	Check(ring.capacity == 4);
+
+	wb_arenaDestroy(heap->pool.alloc);
+	wb_arenaDestroy(pool->alloc);
+	wb_arenaDestroy(arena);
+}
+#endif
+
 int main()
 {
 	int i;
@@ -39,7 +1864,7 @@ int main()
 	printf("Memory Arena test\n");
 	/* Bootstrapping the arena means that it allocates the memory
 	   for itself, then stores its own struct at the beginning */
-	arena = wb_arenaBootstrap(info, wb_FlagArenaNormal);
+	arena = wb_arenaBootstrap(info, wb_Arena_Normal);
 
 	/* Make some room for numbers! */
 	numbers1 = wb_arenaPush(arena, sizeof(int) * 10);
@@ -78,7 +1903,7 @@ int main()
 	printf("(can you see the free list?)\n");
 	/* Internally, the pool creates a memory arena and does the same
 	 * trick the arena does. */
-	pool = wb_poolBootstrap(info, 8, wb_FlagPoolNormal);
+	pool = wb_poolBootstrap(info, 8, wb_Pool_Normal);
 
 	/* Get pointers to numbers out of the pool, give them some funky values */
 	/* wb_usize* soManyNumbers[100]; */
@@ -126,7 +1951,7 @@ int main()
 			sizeof(wb_usize) * 65, 
 			/* normally the arena size would be 
 			   something like wb_CalcMegabytes(2) */
-			wb_FlagTaggedHeapNormal);
+			wb_TaggedHeap_Normal);
 
 	/* This'll allow us to neatly print out the memory layout */
 	memoryView = heap->pool.slots;
@@ -145,10 +1970,12 @@ int main()
 	}
 
 	/* You get to see the memory layout of the TaggedHeapArena structs too
-	 * struct TaggedHeapArnea {
+	 * struct TaggedHeapArena {
 	 *     wb_isize tag;
 	 *     TaggedHeapArena* next;
+	 *     TaggedHeapArena *binNext, *binPrev;
 	 *     void *head, *end;
+	 *     wb_iflags flags;
 	 *     char buffer;
 	 * }
 	 * Something to note: buffer gets padded out to 8 bytes, so this struct
@@ -176,6 +2003,35 @@ int main()
 	 * before, destroying that wipes the whole thing. */
 	wb_arenaDestroy(heap->pool.alloc);
 
-	return 0;
+	testPoolBatch(info);
+	testPoolIter(info);
+	testPoolDefragment(info);
+	testSoaPool(info);
+	testPoolTrim(info);
+	testPoolPageSlots(info);
+	testPoolGrowth(info);
+	testPoolSortFreeList(info);
+	testPoolIndexLinks(info);
+	testTaggedConcurrent(info);
+	testTaggedLarge(info);
+	testTaggedHashedTags(info);
+	testTaggedRetire(info);
+	testTaggedMerge(info);
+	testTaggedTrim(info);
+	testTaggedBestFit(info);
+	testTaggedSizeClasses(info);
+	testTaggedModes(info);
+	testTaggedZeroBlocks(info);
+	testTaggedUsedSpan(info);
+	testTaggedPool(info);
+	testTaggedDeferred(info);
+	testTaggedEvacuate(info);
+	testStats(info);
+#ifdef WB_ALLOC_TRACE
+	testTrace(info);
+#endif
+
+	printf("\n%d checks failed\n", testFailures);
+	return testFailures ? 1 : 0;
 }
 
@@ -14,6 +14,59 @@
 #ifdef _MSC_VER
 #pragma warning(disable:189)
 #endif
+
+static int testFailures;
+static void testCheck(bool ok, const char* what, int line)
+{
+	if(!ok) {
+		printf("  FAILED (line %d): %s\n", line, what);
+		testFailures++;
+	}
+}
+#define Check(x) testCheck((x), #x, __LINE__)
+
+static void testPoolBatch(wb_MemoryInfo info)
+{
+	printf("Pool batch test\n");
+	wb_MemoryPool* pool = wb_poolBootstrap<wb_usize>(info, wb_Pool_Normal);
+	wb_usize* ptrs[16];
+	Check(wb_poolRetrieveBatch<wb_usize>(pool, ptrs, 16) == 16);
+	wb_poolReleaseBatch<wb_usize>(pool, ptrs, 16);
+	Check(pool->count == 0);
+	Check(wb_poolRetrieve<wb_usize>(pool) == ptrs[0]);
+	wb_poolDestroy(pool);
+}
+
+static void testPoolIter(wb_MemoryInfo info)
+{
+	printf("Pool iterator test\n");
+	wb_MemoryPool* pool = wb_poolBootstrap<wb_usize>(info, 
+			wb_Pool_TrackOccupancy);
+	for(int i = 0; i < 10; ++i) {
+		*wb_poolRetrieve<wb_usize>(pool) = i;
+	}
+	wb_PoolIterator iter;
+	wb_poolIterBegin(pool, &iter);
+	wb_usize sum = 0;
+	while(wb_usize* ptr = wb_poolIterNext<wb_usize>(&iter)) {
+		sum += *ptr;
+	}
+	Check(sum == 45);
+	wb_poolDestroy(pool);
+}
+
+static void testSoaPool(wb_MemoryInfo info)
+{
+	printf("SoA pool test\n");
+	wb_SoaPool* soa = wb_soaBootstrap<float, double>(info, wb_Pool_Normal);
+	wb_isize index = wb_soaRetrieve(soa);
+	*wb_soaField<float>(soa, 0, index) = 1.5f;
+	*wb_soaField<double>(soa, 1, index) = 2.5;
+	Check(wb_soaColumn<float>(soa, 0)[index] == 1.5f);
+	Check(wb_soaColumn<double>(soa, 1)[index] == 2.5);
+	wb_soaDestroy(soa);
+}
+
 int main()
 {
 	int i;
@@ -28,12 +81,12 @@ int main()
 		   info.commitSize / wb_CalcKilobytes(1));
 
 	printf("Memory Arena test\n");
-	wb_MemoryArena* arena = wb_arenaBootstrap(info, wb_FlagArenaNormal);
+	wb_MemoryArena* arena = wb_arenaBootstrap(info, wb_Arena_Normal);
 
-	int* numbers1 = wb_arenaPush<int, 10>(arena);
-	int* numbers2 = wb_arenaPush<int, 20>(arena);
-	int* numbers3 = wb_arenaPush<int, 40>(arena);
-	int* numbers4 = wb_arenaPush<int, 80>(arena);
+	int* numbers1 = wb_arenaPush<int>(arena, 10);
+	int* numbers2 = wb_arenaPush<int>(arena, 20);
+	int* numbers3 = wb_arenaPush<int>(arena, 40);
+	int* numbers4 = wb_arenaPush<int>(arena, 80);
 
 	for(i = 0; i < 150; ++i) {
 		numbers1[i] = 150 - i;
@@ -56,7 +109,7 @@ int main()
 
 	printf("Memory Pool test\n");
 	printf("(can you see the free list?)\n");
-	wb_MemoryPool* pool = wb_poolBootstrap<wb_usize>(info, wb_FlagPoolNormal);
+	wb_MemoryPool* pool = wb_poolBootstrap<wb_usize>(info, wb_Pool_Normal);
 
 	wb_usize* soManyNumbers[100];
 	for(i = 0; i < 100; ++i) {
@@ -96,12 +149,12 @@ int main()
 			sizeof(wb_usize) * 65, 
 			/* normally the arena size would be 
 			   something like wb_CalcMegabytes(2) */
-			wb_FlagTaggedHeapNormal);
+			wb_TaggedHeap_Normal);
 	wb_usize* memoryView = (wb_usize*)heap->pool.slots;
 
-	wb_usize* aBlock = wb_taggedAlloc<wb_usize, 64>(heap, Tag_A);
-	wb_usize* bBlock = wb_taggedAlloc<wb_usize, 64>(heap, Tag_B);
-	wb_usize* cBlock = wb_taggedAlloc<wb_usize, 64>(heap, Tag_C);
+	wb_usize* aBlock = wb_taggedAlloc<wb_usize>(heap, Tag_A, 64);
+	wb_usize* bBlock = wb_taggedAlloc<wb_usize>(heap, Tag_B, 64);
+	wb_usize* cBlock = wb_taggedAlloc<wb_usize>(heap, Tag_C, 64);
 
 	for(i = 0; i < 64; ++i) {
 		aBlock[i] = i;
@@ -126,7 +179,12 @@ int main()
 
 	wb_arenaDestroy(heap->pool.alloc);
 
-	return 0;
+	testPoolBatch(info);
+	testPoolIter(info);
+	testSoaPool(info);
+
+	printf("\n%d checks failed\n", testFailures);
+	return testFailures ? 1 : 0;
 }
 
 